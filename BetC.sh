@@ -15,13 +15,14 @@ command -v zip >/dev/null 2>&1 || { echo "zip est requis pour l'option de compre
 
 # Fonction d'aide
 usage() {
- echo "Usage: $0 source_directory destination_directory [-j jpg_size_kb] [-m mp4_size_mb] [-g yes|no] [-a yes|no] [-z yes|no] [-r yes|no]"
+ echo "Usage: $0 source_directory destination_directory [-j jpg_size_kb] [-m mp4_size_mb] [-g yes|no] [-a yes|no] [-z yes|no] [-r yes|no] [-p video_slots]"
  echo "  -j: Taille max pour JPG en KB (défaut: 700)"
  echo "  -m: Taille max pour MP4 en MB (défaut: 10)"
  echo "  -g: Utiliser le GPU pour FFmpeg (yes/no, défaut: no)"
  echo "  -a: Récupérer depuis un appareil Android (yes/no, défaut: no)"
  echo "  -z: Compresser le répertoire de destination (yes/no, défaut: no)"
  echo "  -r: Supprimer les fichiers/dossiers indésirables (yes/no, défaut: no)"
+ echo "  -p: Nombre de conversions vidéo simultanées (défaut: 2, les images utilisent tous les cœurs)"
  exit 1
 }
 
@@ -32,6 +33,7 @@ USE_GPU="no"
 USE_ANDROID="no"
 ZIP_DEST="no"
 REMOVE_JUNK="no"
+VIDEO_SLOTS=2
 
 # Vérifier si les arguments minimum sont fournis
 if [ $# -lt 2 ]; then
@@ -51,6 +53,7 @@ while [ $# -gt 0 ]; do
   -a) USE_ANDROID="$2"; [ "$USE_ANDROID" != "yes" ] && [ "$USE_ANDROID" != "no" ] && { echo "Option Android invalide"; usage; }; shift 2 ;;
   -z) ZIP_DEST="$2"; [ "$ZIP_DEST" != "yes" ] && [ "$ZIP_DEST" != "no" ] && { echo "Option zip invalide"; usage; }; shift 2 ;;
   -r) REMOVE_JUNK="$2"; [ "$REMOVE_JUNK" != "yes" ] && [ "$REMOVE_JUNK" != "no" ] && { echo "Option suppression indésirables invalide"; usage; }; shift 2 ;;
+  -p) VIDEO_SLOTS="$2"; [[ "$VIDEO_SLOTS" =~ ^[1-9][0-9]*$ ]] || { echo "Nombre de conversions vidéo invalide"; usage; }; shift 2 ;;
   *) echo "Option inconnue: $1"; usage ;;
  esac
 done
@@ -81,12 +84,111 @@ declare -A sizes_by_ext
 declare -A hashes_by_ext
 declare -A modtimes_by_ext
 
-# Préfixe FFmpeg pour GPU
-FFMPEG_PREFIX="ffmpeg"
+# Compagnon natif (BetC_copy.c compilé à côté du script) : hash, copie et manifeste en parallèle
+BETC_COPY="$(dirname "$0")/BetC_copy"
+
+# Commande FFmpeg (tableau : une affectation VAR=1 issue d'une variable ne serait pas une variable d'environnement)
+FFMPEG_CMD=(ffmpeg)
 if [ "$USE_GPU" = "yes" ]; then
- FFMPEG_PREFIX="__NV_PRIME_RENDER_OFFLOAD=1 __GLX_VENDOR_LIBRARY_NAME=nvidia ffmpeg -hwaccel cuda"
+ FFMPEG_CMD=(env __NV_PRIME_RENDER_OFFLOAD=1 __GLX_VENDOR_LIBRARY_NAME=nvidia ffmpeg -hwaccel cuda)
 fi
 
+# Ordonnanceur : files séparées pour les conversions JPG (un job par cœur) et MP4 (VIDEO_SLOTS jobs)
+CPU_CORES=$(nproc 2>/dev/null || echo 1)
+IMAGE_SLOTS=$CPU_CORES
+[ "$VIDEO_SLOTS" -gt "$CPU_CORES" ] && VIDEO_SLOTS=$CPU_CORES
+# Threads par FFmpeg pour que l'ensemble des slots vidéo occupe les cœurs sans les surcharger
+FFMPEG_THREADS=$((CPU_CORES / VIDEO_SLOTS))
+[ "$FFMPEG_THREADS" -lt 1 ] && FFMPEG_THREADS=1
+# Files d'attente (fichier, destination, extension, taille séparés par des tabulations) et tâches en cours
+image_queue=()
+video_queue=()
+image_next=0
+video_next=0
+image_pids=()
+video_pids=()
+
+# Retirer des files les conversions terminées
+reap_jobs() {
+ local pid
+ local alive=()
+ for pid in "${image_pids[@]}"; do kill -0 "$pid" 2>/dev/null && alive+=("$pid"); done
+ image_pids=("${alive[@]}")
+ alive=()
+ for pid in "${video_pids[@]}"; do kill -0 "$pid" 2>/dev/null && alive+=("$pid"); done
+ video_pids=("${alive[@]}")
+}
+
+# Lancer en tâche de fond autant de conversions en attente que les slots libres le permettent, sans bloquer
+dispatch_jobs() {
+ local file dest_file ext size
+ reap_jobs
+ while [ "$image_next" -lt "${#image_queue[@]}" ] && [ "${#image_pids[@]}" -lt "$IMAGE_SLOTS" ]; do
+  IFS=$'\t' read -r file dest_file ext size <<< "${image_queue[$image_next]}"
+  image_next=$((image_next + 1))
+  convert_single_file "$file" "$dest_file" "$ext" "$size" &
+  image_pids+=("$!")
+ done
+ while [ "$video_next" -lt "${#video_queue[@]}" ] && [ "${#video_pids[@]}" -lt "$VIDEO_SLOTS" ]; do
+  IFS=$'\t' read -r file dest_file ext size <<< "${video_queue[$video_next]}"
+  video_next=$((video_next + 1))
+  convert_single_file "$file" "$dest_file" "$ext" "$size" &
+  video_pids+=("$!")
+ done
+}
+
+# Mettre une conversion dans sa file ; la boucle principale continue les copies pendant ce temps
+schedule_conversion() {
+ case "$3" in
+  jpg|jpeg) image_queue+=("$1"$'\t'"$2"$'\t'"$3"$'\t'"$4") ;;
+  mp4) video_queue+=("$1"$'\t'"$2"$'\t'"$3"$'\t'"$4") ;;
+ esac
+ dispatch_jobs
+}
+
+# Vider les deux files : relancer dès qu'une conversion se termine, puis attendre les dernières
+drain_jobs() {
+ dispatch_jobs
+ while [ "$image_next" -lt "${#image_queue[@]}" ] || [ "$video_next" -lt "${#video_queue[@]}" ] \
+  || [ "${#image_pids[@]}" -gt 0 ] || [ "${#video_pids[@]}" -gt 0 ]; do
+  wait -n || [ $? -ne 127 ] || { image_pids=(); video_pids=(); }
+  dispatch_jobs
+ done
+}
+
+# Fonction pour ré-encoder un JPG ou MP4 trop volumineux (copie si la conversion échoue)
+convert_single_file() {
+ local file="$1"
+ local dest_file="$2"
+ local ext="$3"
+ local size="$4"
+
+ case "$ext" in
+  jpg|jpeg)
+   echo "Conversion de $file (${size}KB) vers une taille réduite (<${JPG_SIZE_KB}KB)..."
+    # Variante de conversion sur la qualité :
+    #convert "$file" -quality 85 -resize 80% "$dest_file" || {
+    # Un seul thread par convert : le parallélisme vient des slots de l'ordonnanceur
+    MAGICK_THREAD_LIMIT=1 convert "$file" -define jpeg:extent="$JPG_SIZE_KB"kb "$dest_file" || {
+    echo "Échec de la conversion de $file"
+    cp "$file" "$dest_file"
+   }
+   ;;
+  mp4)
+   echo "Conversion de $file (${size}KB) vers une taille réduite (<${MP4_SIZE_MB}MB)..."
+   # Exécuter FFmpeg et attendre explicitement sa fin
+   #"${FFMPEG_CMD[@]}" -i "$file" -filter_complex 'fps=24,scale=854:480' -c:v libx264 -pix_fmt yuv420p -c:a mp3 "$dest_file"
+   # test de fonctionnement
+   #ffmpeg -i "$file" -c:v libx264 -pix_fmt yuv420p -vf fps=24,scale=854:480 -c:a mp3 "$dest_file" -y </dev/null 2>/dev/null
+   # Vérifier l'état de FFmpeg directement : lancé par l'ordonnanceur en tâche de fond, $! désignerait une autre conversion
+   if ! "${FFMPEG_CMD[@]}" -i "$file" -c:v libx264 -pix_fmt yuv420p -vf fps=24,scale=854:480 -c:a mp3 -threads "$FFMPEG_THREADS" "$dest_file" -y </dev/null 2>/dev/null; then
+    echo "Échec de la conversion de $file"
+    cp "$file" "$dest_file"
+   fi
+   ;;
+ esac
+}
+
 # Fonction pour traiter un fichier individuellement
 process_single_file() {
  local file="$1"
@@ -120,13 +222,7 @@ process_single_file() {
  case "$ext" in
   jpg|jpeg)
    if [ "$size" -gt "$JPG_SIZE_KB" ]; then
-    echo "Conversion de $file (${size}KB) vers une taille réduite (<${JPG_SIZE_KB}KB)..."
-     # Variante de conversion sur la qualité :
-     #convert "$file" -quality 85 -resize 80% "$dest_file" || {
-     convert "$file" -define jpeg:extent="$JPG_SIZE_KB"kb "$dest_file" || {
-     echo "Échec de la conversion de $file"
-     cp "$file" "$dest_file"
-    }
+    schedule_conversion "$file" "$dest_file" "$ext" "$size"
    else
     cp "$file" "$dest_file" || echo "Échec de la copie de $file"
    fi
@@ -134,22 +230,7 @@ process_single_file() {
   mp4)
    max_size=$((MP4_SIZE_MB * 1024))
    if [ "$size" -gt "$max_size" ]; then
-    echo "Conversion de $file (${size}KB) vers une taille réduite (<${MP4_SIZE_MB}MB)..."
-    # Exécuter FFmpeg et attendre explicitement sa fin
-    #$FFMPEG_PREFIX ffmpeg -i "$file" -filter_complex 'fps=24,scale=854:480' -c:v libx264 -pix_fmt yuv420p -c:a mp3 "$dest_file"
-    to_eval_encode_video="echo '$FFMPEG_PREFIX -i $file -c:v libx264 -pix_fmt yuv420p -vf fps=24,scale=854:480 -c:a mp3 $dest_file'"
-    echo "debug : executing $to_eval_encode_video"
-    eval "$to_eval_encode_video" 
-    $FFMPEG_PREFIX -i $file -c:v libx264 -pix_fmt yuv420p -vf fps=24,scale=854:480 -c:a mp3 $dest_file -y </dev/null 2>/dev/null
-    # test de fonctionnement
-    #ffmpeg -i "$file" -c:v libx264 -pix_fmt yuv420p -vf fps=24,scale=854:480 -c:a mp3 "$dest_file" -y </dev/null 2>/dev/null
-    ffmpeg_pid=$!  # Capturer le PID du dernier processus en arrière-plan (bien que non nécessaire ici car pas en arrière-plan)
-    wait $ffmpeg_pid  # Attendre spécifiquement la fin de FFmpeg
-    # Vérifier l'état après que FFmpeg soit terminé
-    if [ $? -ne 0 ]; then
-     echo "Échec de la conversion de $file"
-     cp "$file" "$dest_file"
-    fi
+    schedule_conversion "$file" "$dest_file" "$ext" "$size"
    else
     cp "$file" "$dest_file" || echo "Échec de la copie de $file"
    fi
@@ -167,10 +248,36 @@ process_files() {
  
  echo "Traitement des fichiers depuis $src_dir..."
  
- # Trouver tous les fichiers et les traiter un par un
- find "$src_dir" -type f -print0 | while IFS= read -r -d '' file; do
+ # Avec BetC_copy : une seule passe native par fichier (SHA-256, taille, date, copie reflink/copy_file_range),
+ # le script ne fait plus que remplir les tableaux depuis le manifeste et lancer les conversions ;
+ # le manifeste est lu au fil de l'eau (-s) pour que les conversions démarrent pendant les copies
+ if [ -x "$BETC_COPY" ]; then
+  while IFS=$'\t' read -r ext size hash modtime action relative_path; do
+   file="$src_dir/$relative_path"
+   files_by_ext["$ext"]+="${file}"$'\n'
+   sizes_by_ext["$ext"]+="${size}"$'\n'
+   hashes_by_ext["$ext"]+="${hash}"$'\n'
+   modtimes_by_ext["$ext"]+="${modtime}"$'\n'
+   if [ "$action" = "convert" ]; then
+    schedule_conversion "$file" "$dest_dir/$relative_path" "$ext" "$size"
+   else
+    dispatch_jobs
+   fi
+  done < <("$BETC_COPY" "$src_dir" "$dest_dir" -j "$JPG_SIZE_KB" -m "$MP4_SIZE_MB" -s \
+   || echo "Des erreurs sont survenues pendant la copie native" >&2)
+  drain_jobs
+  return
+ fi
+
+ # Trouver tous les fichiers et les traiter un par un (copies au fil de l'eau, conversions en parallèle) ;
+ # substitution de processus plutôt que pipe pour que les tâches de fond restent dans ce shell
+ while IFS= read -r -d '' file; do
   process_single_file "$file" "$src_dir" "$dest_dir"
- done
+  # Relancer les conversions dont le slot s'est libéré pendant la copie
+  dispatch_jobs
+ done < <(find "$src_dir" -type f -print0)
+ # Attendre la fin de toutes les conversions avant le nettoyage et la compression
+ drain_jobs
 }
 
 # Fonction pour supprimer les fichiers et dossiers indésirables
@@ -210,6 +317,7 @@ echo "Utilisation GPU: $USE_GPU"
 echo "Utilisation Android: $USE_ANDROID"
 echo "Compression destination: $ZIP_DEST"
 echo "Suppression indésirables: $REMOVE_JUNK"
+echo "Conversions simultanées: ${IMAGE_SLOTS} images, ${VIDEO_SLOTS} vidéos (${FFMPEG_THREADS} threads FFmpeg)"
 
 process_files "$SOURCE_DIR" "$DEST_DIR"
 remove_junk "$DEST_DIR"
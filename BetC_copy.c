@@ -0,0 +1,454 @@
+// By Thibaut LOMBARD (LombardWeb)
+// Native companion of BetC.sh : walk the source tree on a thread pool, compute SHA-256, size and mtime of each
+// file in one read pass, copy it (FICLONE reflink or copy_file_range) and print the manifest BetC.sh sorts by extension.
+// With -s each manifest line is printed as soon as its file is done, so BetC.sh can start conversions early.
+// JPG/MP4 files above the BetC.sh thresholds are only hashed and marked "convert", BetC.sh re-encodes them.
+// Compile : gcc -O2 -pthread -o BetC_copy BetC_copy.c
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+#define MAX_PATH 4096
+#define EXT_LEN 32
+#define QUEUE_SIZE 1024
+#define CHUNK_SIZE (1 << 20)
+
+// SHA-256 (FIPS 180-4)
+typedef struct {
+ uint32_t state[8];
+ uint64_t length;
+ unsigned char block[64];
+ size_t used;
+} Sha256;
+
+static const uint32_t sha256_k[64] = {
+ 0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+ 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+ 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+ 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+ 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+ 0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+ 0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+ 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_init(Sha256 *ctx) {
+ static const uint32_t iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+ memcpy(ctx->state, iv, sizeof(iv));
+ ctx->length = 0;
+ ctx->used = 0;
+}
+
+static void sha256_block(Sha256 *ctx, const unsigned char *p) {
+ uint32_t w[64], s[8];
+ for (int i = 0; i < 16; i++) {
+  w[i] = ((uint32_t)p[i * 4] << 24) | ((uint32_t)p[i * 4 + 1] << 16) | ((uint32_t)p[i * 4 + 2] << 8) | p[i * 4 + 3];
+ }
+ for (int i = 16; i < 64; i++) {
+  uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+  uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+  w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+ }
+ memcpy(s, ctx->state, sizeof(s));
+ for (int i = 0; i < 64; i++) {
+  uint32_t t1 = s[7] + (ROTR(s[4], 6) ^ ROTR(s[4], 11) ^ ROTR(s[4], 25)) + ((s[4] & s[5]) ^ (~s[4] & s[6])) + sha256_k[i] + w[i];
+  uint32_t t2 = (ROTR(s[0], 2) ^ ROTR(s[0], 13) ^ ROTR(s[0], 22)) + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+  memmove(s + 1, s, 7 * sizeof(uint32_t));
+  s[4] += t1;
+  s[0] = t1 + t2;
+ }
+ for (int i = 0; i < 8; i++) ctx->state[i] += s[i];
+}
+
+static void sha256_update(Sha256 *ctx, const unsigned char *data, size_t len) {
+ ctx->length += len;
+ if (ctx->used) {
+  size_t take = 64 - ctx->used < len ? 64 - ctx->used : len;
+  memcpy(ctx->block + ctx->used, data, take);
+  ctx->used += take;
+  data += take;
+  len -= take;
+  if (ctx->used < 64) return;
+  sha256_block(ctx, ctx->block);
+  ctx->used = 0;
+ }
+ for (; len >= 64; data += 64, len -= 64) sha256_block(ctx, data);
+ memcpy(ctx->block, data, len);
+ ctx->used = len;
+}
+
+static void sha256_hex(Sha256 *ctx, char *hex) {
+ uint64_t bits = ctx->length * 8;
+ unsigned char pad = 0x80, zero = 0, len_be[8];
+ sha256_update(ctx, &pad, 1);
+ while (ctx->used != 56) sha256_update(ctx, &zero, 1);
+ for (int i = 0; i < 8; i++) len_be[i] = bits >> (56 - 8 * i);
+ sha256_update(ctx, len_be, 8);
+ for (int i = 0; i < 8; i++) sprintf(hex + i * 8, "%08x", ctx->state[i]);
+}
+
+// One manifest line
+typedef struct {
+ char ext[EXT_LEN];
+ long size_kb;
+ char hash[65];
+ char modtime[64];
+ bool convert;
+ char *rel_path;
+} Entry;
+
+// Global variables
+char *source_dir = NULL;
+char *dest_dir = NULL;
+long jpg_size_kb = 700;
+long mp4_size_mb = 10;
+atomic_bool has_errors = false;  // set by every worker
+bool stream = false;
+FILE *manifest = NULL;
+
+Entry *entries = NULL;
+size_t entry_count = 0, entry_cap = 0;
+pthread_mutex_t entries_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Bounded queue of relative paths feeding the workers
+struct {
+ char *paths[QUEUE_SIZE];
+ int head, tail, count, done;
+ pthread_mutex_t lock;
+ pthread_cond_t not_empty, not_full;
+} queue = {
+ .lock = PTHREAD_MUTEX_INITIALIZER,
+ .not_empty = PTHREAD_COND_INITIALIZER,
+ .not_full = PTHREAD_COND_INITIALIZER
+};
+
+void usage(const char *prog_name) {
+ fprintf(stderr, "Usage: %s source_directory destination_directory [-j jpg_size_kb] [-m mp4_size_mb] [-t threads] [-o manifest] [-s]\n", prog_name);
+ fprintf(stderr, "Manifest (tab separated, sorted by extension): ext size_kb sha256 mtime copy|convert relative_path\n");
+ fprintf(stderr, "  -s: stream the manifest unsorted, one line as each file is done\n");
+ exit(EXIT_FAILURE);
+}
+
+// Extension in lower case as BetC.sh computes it (".nomedia" has the extension "nomedia"), false when the file has none
+static bool get_extension(const char *name, char *ext) {
+ const char *dot = strrchr(name, '.');
+ if (!dot || strlen(dot + 1) >= EXT_LEN || dot[1] == '\0') return false;
+ size_t i = 0;
+ for (const char *p = dot + 1; *p; p++) ext[i++] = tolower((unsigned char)*p);
+ ext[i] = '\0';
+ return true;
+}
+
+// Same layout as `stat -c %y`
+static void format_mtime(const struct stat *st, char *out, size_t len) {
+ struct tm tm;
+ char date[32], zone[8];
+ localtime_r(&st->st_mtim.tv_sec, &tm);
+ strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm);
+ strftime(zone, sizeof(zone), "%z", &tm);
+ snprintf(out, len, "%s.%09ld %s", date, st->st_mtim.tv_nsec, zone);
+}
+
+static bool same_file(const struct stat *a, const struct stat *b) {
+ return a->st_dev == b->st_dev && a->st_ino == b->st_ino;
+}
+
+static int make_parents(const char *path) {
+ char tmp[MAX_PATH];
+ snprintf(tmp, MAX_PATH, "%s", path);
+ for (char *p = tmp + 1; *p; p++) {
+  if (*p != '/') continue;
+  *p = '\0';
+  if (mkdir(tmp, 0755) != 0 && errno != EEXIST) return -1;
+  *p = '/';
+ }
+ return 0;
+}
+
+// Hash the file in one read pass and copy it: reflink when the filesystem allows it, otherwise each chunk
+// just read is handed to copy_file_range (served from the page cache) or written back
+static int hash_and_copy(int in, int out, Sha256 *sha, unsigned char *buf) {
+ bool cloned = out >= 0 && ioctl(out, FICLONE, in) == 0;
+ bool use_cfr = out >= 0 && !cloned;
+ off_t off = 0;
+ ssize_t n;
+
+ while ((n = pread(in, buf, CHUNK_SIZE, off)) > 0) {
+  sha256_update(sha, buf, n);
+  if (out >= 0 && !cloned) {
+   ssize_t done = 0;
+   if (use_cfr) {
+    loff_t in_off = off, out_off = off;
+    while (done < n) {
+     ssize_t c = copy_file_range(in, &in_off, out, &out_off, n - done, 0);
+     if (c <= 0) break;
+     done += c;
+    }
+    if (done < n) use_cfr = false;  // EXDEV, ENOSYS... fall back to plain writes
+   }
+   if (done < n && pwrite(out, buf + done, n - done, off + done) != n - done) return -1;
+  }
+  off += n;
+ }
+ return n < 0 ? -1 : 0;
+}
+
+static void print_entry(const Entry *e) {
+ fprintf(manifest, "%s\t%ld\t%s\t%s\t%s\t%s\n", e->ext, e->size_kb, e->hash, e->modtime,
+   e->convert ? "convert" : "copy", e->rel_path);
+}
+
+static void process_file(const char *rel_path, unsigned char *buf) {
+ char src_path[MAX_PATH], dst_path[MAX_PATH];
+ Entry e;
+ memset(&e, 0, sizeof(e));
+
+ const char *name = strrchr(rel_path, '/');
+ name = name ? name + 1 : rel_path;
+ if (!get_extension(name, e.ext)) return;  // BetC.sh ignores files without extension
+
+ snprintf(src_path, MAX_PATH, "%s/%s", source_dir, rel_path);
+ snprintf(dst_path, MAX_PATH, "%s/%s", dest_dir, rel_path);
+ int in = open(src_path, O_RDONLY);
+ struct stat st;
+ if (in < 0 || fstat(in, &st) != 0) {
+  fprintf(stderr, "Cannot read %s: %s\n", src_path, strerror(errno));
+  if (in >= 0) close(in);
+  has_errors = true;
+  return;
+ }
+
+ // du -k reports allocated blocks, keep the same unit for the thresholds
+ e.size_kb = st.st_blocks / 2;
+ format_mtime(&st, e.modtime, sizeof(e.modtime));
+ if (strcmp(e.ext, "jpg") == 0 || strcmp(e.ext, "jpeg") == 0) e.convert = e.size_kb > jpg_size_kb;
+ else if (strcmp(e.ext, "mp4") == 0) e.convert = e.size_kb > mp4_size_mb * 1024;
+
+ // Destination directories exist for converted files too, BetC.sh writes them there.
+ // When source and destination are the same tree (BetC.sh -a yes) the file is only hashed: it is
+ // opened without O_TRUNC and truncated once it is known to be another file.
+ int out = -1;
+ struct stat dst_st;
+ bool in_place = stat(dst_path, &dst_st) == 0 && same_file(&st, &dst_st);
+ if (make_parents(dst_path) != 0) {
+  fprintf(stderr, "Cannot create directories for %s: %s\n", dst_path, strerror(errno));
+  has_errors = true;
+ } else if (!e.convert && !in_place && (out = open(dst_path, O_WRONLY | O_CREAT, st.st_mode & 07777)) < 0) {
+  fprintf(stderr, "Cannot create %s: %s\n", dst_path, strerror(errno));
+  has_errors = true;
+ } else if (out >= 0) {
+  if (fstat(out, &dst_st) != 0 || (!same_file(&st, &dst_st) && ftruncate(out, 0) != 0)) {
+   fprintf(stderr, "Cannot truncate %s: %s\n", dst_path, strerror(errno));
+   has_errors = true;
+   close(out);
+   out = -1;
+  } else if (same_file(&st, &dst_st)) {
+   close(out);
+   out = -1;
+  }
+ }
+
+ Sha256 sha;
+ sha256_init(&sha);
+ if (hash_and_copy(in, out, &sha, buf) != 0) {
+  fprintf(stderr, "Copy of %s failed: %s\n", src_path, strerror(errno));
+  has_errors = true;
+ }
+ sha256_hex(&sha, e.hash);
+ close(in);
+ if (out >= 0) close(out);
+
+ if (stream) {
+  e.rel_path = (char *)rel_path;
+  pthread_mutex_lock(&entries_lock);
+  print_entry(&e);
+  fflush(manifest);
+  pthread_mutex_unlock(&entries_lock);
+  return;
+ }
+
+ e.rel_path = strdup(rel_path);
+ pthread_mutex_lock(&entries_lock);
+ if (entry_count == entry_cap) {
+  size_t cap = entry_cap ? entry_cap * 2 : 1024;
+  Entry *grown = realloc(entries, cap * sizeof(Entry));
+  if (!grown) {
+   pthread_mutex_unlock(&entries_lock);
+   fprintf(stderr, "Memory allocation failed\n");
+   exit(EXIT_FAILURE);
+  }
+  entries = grown;
+  entry_cap = cap;
+ }
+ entries[entry_count++] = e;
+ pthread_mutex_unlock(&entries_lock);
+}
+
+static void queue_push(const char *rel_path) {
+ char *copy = strdup(rel_path);
+ if (!copy) return;
+ pthread_mutex_lock(&queue.lock);
+ while (queue.count == QUEUE_SIZE) pthread_cond_wait(&queue.not_full, &queue.lock);
+ queue.paths[queue.tail] = copy;
+ queue.tail = (queue.tail + 1) % QUEUE_SIZE;
+ queue.count++;
+ pthread_cond_signal(&queue.not_empty);
+ pthread_mutex_unlock(&queue.lock);
+}
+
+static char *queue_pop(void) {
+ pthread_mutex_lock(&queue.lock);
+ while (queue.count == 0 && !queue.done) pthread_cond_wait(&queue.not_empty, &queue.lock);
+ char *path = NULL;
+ if (queue.count > 0) {
+  path = queue.paths[queue.head];
+  queue.head = (queue.head + 1) % QUEUE_SIZE;
+  queue.count--;
+  pthread_cond_signal(&queue.not_full);
+ }
+ pthread_mutex_unlock(&queue.lock);
+ return path;
+}
+
+static void *worker(void *arg) {
+ (void)arg;
+ unsigned char *buf = malloc(CHUNK_SIZE);
+ if (!buf) return NULL;
+ char *path;
+ while ((path = queue_pop())) {
+  process_file(path, buf);
+  free(path);
+ }
+ free(buf);
+ return NULL;
+}
+
+// Walk the source tree, rel_dir is relative to source_dir ("" for the root)
+static void walk_directory(const char *rel_dir) {
+ char dir_path[MAX_PATH], rel_path[MAX_PATH];
+ snprintf(dir_path, MAX_PATH, "%s%s%s", source_dir, *rel_dir ? "/" : "", rel_dir);
+ DIR *dir = opendir(dir_path);
+ if (!dir) {
+  fprintf(stderr, "Cannot open directory %s: %s\n", dir_path, strerror(errno));
+  has_errors = true;
+  return;
+ }
+
+ struct dirent *entry;
+ while ((entry = readdir(dir)) != NULL) {
+  if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+  if (snprintf(rel_path, MAX_PATH, "%s%s%s", rel_dir, *rel_dir ? "/" : "", entry->d_name) >= MAX_PATH) continue;
+
+  unsigned char type = entry->d_type;
+  if (type == DT_UNKNOWN || type == DT_LNK) {
+   // Follow what find -type f reports: regular files, no symlinks
+   char full_path[MAX_PATH + 258];
+   struct stat st;
+   snprintf(full_path, sizeof(full_path), "%s/%s", dir_path, entry->d_name);
+   if (lstat(full_path, &st) != 0) continue;
+   type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+  }
+  if (type == DT_DIR) {
+   walk_directory(rel_path);
+  } else if (type == DT_REG) {
+   queue_push(rel_path);
+  }
+ }
+ closedir(dir);
+}
+
+static int compare_entries(const void *a, const void *b) {
+ const Entry *ea = a, *eb = b;
+ int c = strcmp(ea->ext, eb->ext);
+ return c ? c : strcmp(ea->rel_path, eb->rel_path);
+}
+
+int main(int argc, char *argv[]) {
+ if (argc < 3) usage(argv[0]);
+
+ source_dir = argv[1];
+ dest_dir = argv[2];
+ int threads = 0;
+ char *manifest_path = NULL;
+
+ for (int i = 3; i < argc; i++) {
+  if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+   jpg_size_kb = atol(argv[++i]);
+  } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+   mp4_size_mb = atol(argv[++i]);
+  } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+   threads = atoi(argv[++i]);
+  } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+   manifest_path = argv[++i];
+  } else if (strcmp(argv[i], "-s") == 0) {
+   stream = true;
+  } else {
+   fprintf(stderr, "Unknown option: %s\n", argv[i]);
+   usage(argv[0]);
+  }
+ }
+
+ // Trailing slashes would end up in the relative paths
+ size_t len = strlen(source_dir);
+ while (len > 1 && source_dir[len - 1] == '/') source_dir[--len] = '\0';
+ len = strlen(dest_dir);
+ while (len > 1 && dest_dir[len - 1] == '/') dest_dir[--len] = '\0';
+
+ struct stat st;
+ if (stat(source_dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+  fprintf(stderr, "Error: source directory '%s' does not exist\n", source_dir);
+  return EXIT_FAILURE;
+ }
+ manifest = manifest_path ? fopen(manifest_path, "w") : stdout;
+ if (!manifest) {
+  perror("Error opening manifest");
+  return EXIT_FAILURE;
+ }
+ if (threads <= 0) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  threads = cpus > 0 ? (int)cpus : 1;
+ }
+
+ pthread_t *workers = calloc(threads, sizeof(pthread_t));
+ if (!workers) return EXIT_FAILURE;
+ for (int i = 0; i < threads; i++) {
+  if (pthread_create(&workers[i], NULL, worker, NULL) != 0) {
+   fprintf(stderr, "Error: cannot start worker thread\n");
+   return EXIT_FAILURE;
+  }
+ }
+ walk_directory("");
+ pthread_mutex_lock(&queue.lock);
+ queue.done = 1;
+ pthread_cond_broadcast(&queue.not_empty);
+ pthread_mutex_unlock(&queue.lock);
+ for (int i = 0; i < threads; i++) pthread_join(workers[i], NULL);
+ free(workers);
+
+ // Manifest grouped by extension, like the *_by_ext arrays of BetC.sh
+ qsort(entries, entry_count, sizeof(Entry), compare_entries);
+ for (size_t i = 0; i < entry_count; i++) {
+  print_entry(&entries[i]);
+  free(entries[i].rel_path);
+ }
+ free(entries);
+ if (manifest != stdout) fclose(manifest);
+
+ return has_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
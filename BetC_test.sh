@@ -10,3 +10,23 @@ __NV_PRIME_RENDER_OFFLOAD=1 __GLX_VENDOR_LIBRARY_NAME=nvidia ffmpeg -hwaccel cud
 echo "2eme commande executée en $SECONDS secondes"
 stop=$EPOCHREALTIME
 echo "Difference $((SECONDS - firststop)). NB: Si le nombre est négatif la seconde commande est plus rapide que la premiere"
+
+# Non-régression BetC_copy : avec -a yes, BetC.sh copie la destination sur elle-même (SOURCE_DIR="$DEST_DIR"),
+# les fichiers ne doivent pas être tronqués
+BETC_COPY="$(dirname "$0")/BetC_copy"
+if [ -x "$BETC_COPY" ]; then
+ test_dir=$(mktemp -d)
+ mkdir -p "$test_dir/sous_dossier"
+ head -c 4096 /dev/urandom > "$test_dir/photo.jpg"
+ head -c 2048 /dev/urandom > "$test_dir/sous_dossier/video.mp4"
+ before=$(cd "$test_dir" && sha256sum photo.jpg sous_dossier/video.mp4)
+ "$BETC_COPY" "$test_dir" "$test_dir" > /dev/null
+ after=$(cd "$test_dir" && sha256sum photo.jpg sous_dossier/video.mp4)
+ rm -rf "$test_dir"
+ if [ "$before" = "$after" ]; then
+  echo "BetC_copy source = destination : fichiers intacts"
+ else
+  echo "BetC_copy source = destination : fichiers modifiés"
+  exit 1
+ fi
+fi
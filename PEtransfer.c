@@ -3,126 +3,544 @@
 // -s flag to copy the section table from the source file, while still preserving the target’s .rsrc section for icons.
 // Default to copying only the PE header (DOS Header + NT Headers) without the section table if the flag isn’t provided.
 // keep icon checking step.
+// Portable: the PE structures are declared here, files are mmap'd and every offset is checked against the mapping size.
+// --targets applies one source header to a list of files or a directory, in parallel, each target replaced atomically.
+// -c recomputes the target's CheckSum after the transfer instead of keeping the source's value.
+// --inspect prints one JSON line per binary (headers, sections, resource tree summary), directories are scanned on threads.
+// Compile : gcc -O2 -pthread -o PEtransfer PEtransfer.c
 
+#define _GNU_SOURCE
 #include <stdio.h>
-#include <windows.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-void copy_pe_header_with_resources(const char *source_file, const char *target_file, int copy_sections) {
- FILE *source = fopen(source_file, "rb");
- if (!source) {
-  perror("Error opening source file");
-  return;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "PEtransfer maps the little endian PE structures directly, build it on a little endian host"
+#endif
+
+#define DOS_SIGNATURE 0x5A4D      // "MZ"
+#define NT_SIGNATURE 0x00004550   // "PE\0\0"
+#define OPT_MAGIC_PE32 0x10B
+#define OPT_MAGIC_PE32PLUS 0x20B
+#define NUMBEROF_DIRECTORY_ENTRIES 16
+#define DIRECTORY_ENTRY_RESOURCE 2
+#define RT_ICON 3
+#define RT_GROUP_ICON 14
+#define RESOURCE_MAX_DEPTH 3  // type, name, language
+#define RESOURCE_MAX_ENTRIES 65536  // directory entries visited over the whole tree
+#define MAX_PATH 4096
+#define CHECKSUM_OFFSET 64  // CheckSum position in both PE32 and PE32+ optional headers
+
+// Global flags
+int fix_checksum = 0;
+
+#pragma pack(push, 1)
+
+typedef struct {
+ uint16_t e_magic;
+ uint16_t e_cblp;
+ uint16_t e_cp;
+ uint16_t e_crlc;
+ uint16_t e_cparhdr;
+ uint16_t e_minalloc;
+ uint16_t e_maxalloc;
+ uint16_t e_ss;
+ uint16_t e_sp;
+ uint16_t e_csum;
+ uint16_t e_ip;
+ uint16_t e_cs;
+ uint16_t e_lfarlc;
+ uint16_t e_ovno;
+ uint16_t e_res[4];
+ uint16_t e_oemid;
+ uint16_t e_oeminfo;
+ uint16_t e_res2[10];
+ int32_t e_lfanew;
+} DosHeader;
+
+typedef struct {
+ uint16_t Machine;
+ uint16_t NumberOfSections;
+ uint32_t TimeDateStamp;
+ uint32_t PointerToSymbolTable;
+ uint32_t NumberOfSymbols;
+ uint16_t SizeOfOptionalHeader;
+ uint16_t Characteristics;
+} CoffHeader;
+
+typedef struct {
+ uint32_t VirtualAddress;
+ uint32_t Size;
+} DataDirectory;
+
+typedef struct {
+ uint16_t Magic;
+ uint8_t MajorLinkerVersion;
+ uint8_t MinorLinkerVersion;
+ uint32_t SizeOfCode;
+ uint32_t SizeOfInitializedData;
+ uint32_t SizeOfUninitializedData;
+ uint32_t AddressOfEntryPoint;
+ uint32_t BaseOfCode;
+ uint32_t BaseOfData;
+ uint32_t ImageBase;
+ uint32_t SectionAlignment;
+ uint32_t FileAlignment;
+ uint16_t MajorOperatingSystemVersion;
+ uint16_t MinorOperatingSystemVersion;
+ uint16_t MajorImageVersion;
+ uint16_t MinorImageVersion;
+ uint16_t MajorSubsystemVersion;
+ uint16_t MinorSubsystemVersion;
+ uint32_t Win32VersionValue;
+ uint32_t SizeOfImage;
+ uint32_t SizeOfHeaders;
+ uint32_t CheckSum;
+ uint16_t Subsystem;
+ uint16_t DllCharacteristics;
+ uint32_t SizeOfStackReserve;
+ uint32_t SizeOfStackCommit;
+ uint32_t SizeOfHeapReserve;
+ uint32_t SizeOfHeapCommit;
+ uint32_t LoaderFlags;
+ uint32_t NumberOfRvaAndSizes;
+ DataDirectory DataDirectory[NUMBEROF_DIRECTORY_ENTRIES];
+} OptionalHeader32;
+
+typedef struct {
+ uint16_t Magic;
+ uint8_t MajorLinkerVersion;
+ uint8_t MinorLinkerVersion;
+ uint32_t SizeOfCode;
+ uint32_t SizeOfInitializedData;
+ uint32_t SizeOfUninitializedData;
+ uint32_t AddressOfEntryPoint;
+ uint32_t BaseOfCode;
+ uint64_t ImageBase;
+ uint32_t SectionAlignment;
+ uint32_t FileAlignment;
+ uint16_t MajorOperatingSystemVersion;
+ uint16_t MinorOperatingSystemVersion;
+ uint16_t MajorImageVersion;
+ uint16_t MinorImageVersion;
+ uint16_t MajorSubsystemVersion;
+ uint16_t MinorSubsystemVersion;
+ uint32_t Win32VersionValue;
+ uint32_t SizeOfImage;
+ uint32_t SizeOfHeaders;
+ uint32_t CheckSum;
+ uint16_t Subsystem;
+ uint16_t DllCharacteristics;
+ uint64_t SizeOfStackReserve;
+ uint64_t SizeOfStackCommit;
+ uint64_t SizeOfHeapReserve;
+ uint64_t SizeOfHeapCommit;
+ uint32_t LoaderFlags;
+ uint32_t NumberOfRvaAndSizes;
+ DataDirectory DataDirectory[NUMBEROF_DIRECTORY_ENTRIES];
+} OptionalHeader64;
+
+typedef struct {
+ uint8_t Name[8];
+ uint32_t VirtualSize;
+ uint32_t VirtualAddress;
+ uint32_t SizeOfRawData;
+ uint32_t PointerToRawData;
+ uint32_t PointerToRelocations;
+ uint32_t PointerToLinenumbers;
+ uint16_t NumberOfRelocations;
+ uint16_t NumberOfLinenumbers;
+ uint32_t Characteristics;
+} SectionHeader;
+
+typedef struct {
+ uint32_t Characteristics;
+ uint32_t TimeDateStamp;
+ uint16_t MajorVersion;
+ uint16_t MinorVersion;
+ uint16_t NumberOfNamedEntries;
+ uint16_t NumberOfIdEntries;
+} ResourceDirectory;
+
+typedef struct {
+ uint32_t Name;          // high bit set: name string, else integer id
+ uint32_t OffsetToData;  // high bit set: subdirectory
+} ResourceDirectoryEntry;
+
+typedef struct {
+ uint32_t OffsetToData;  // RVA of the resource data
+ uint32_t Size;
+ uint32_t CodePage;
+ uint32_t Reserved;
+} ResourceDataEntry;
+
+#pragma pack(pop)
+
+// A mapped PE file, every pointer below lies inside [base, base + size)
+typedef struct {
+ const char *path;
+ int fd;
+ unsigned char *base;
+ size_t size;
+ DosHeader *dos;
+ uint32_t nt_off;           // e_lfanew
+ size_t nt_len;             // signature + COFF header + optional header
+ CoffHeader *coff;
+ unsigned char *opt;
+ int pe32plus;
+ uint32_t size_of_headers;
+ DataDirectory *dirs;
+ uint32_t dir_count;
+ SectionHeader *sections;
+ uint16_t section_count;
+ char error[MAX_PATH + 128];
+} PeImage;
+
+// Leaves of the resource tree, counted per interesting type
+typedef struct {
+ int types;
+ int leaves;
+ int icons;
+ int group_icons;
+ int invalid;  // leaves whose data is not backed by the file
+ int entries;  // directory entries visited, bounded by RESOURCE_MAX_ENTRIES
+} ResourceStats;
+
+// Record why a file was rejected, callers decide whether and how to print it
+static int pe_fail(PeImage *pe, const char *format, ...) {
+ va_list args;
+ int len = snprintf(pe->error, sizeof(pe->error), "%s: ", pe->path);
+ va_start(args, format);
+ vsnprintf(pe->error + len, sizeof(pe->error) - len, format, args);
+ va_end(args);
+ return -1;
+}
+
+// The reason part of pe->error, without the "path: " prefix
+static const char *pe_reason(const PeImage *pe) {
+ size_t len = strlen(pe->path) + 2;
+ return len < strlen(pe->error) ? pe->error + len : pe->error;
+}
+
+// Format an error into a caller supplied buffer, returns -1 for the caller to pass on
+static int set_error(char *error, size_t error_len, const char *format, ...) {
+ va_list args;
+ va_start(args, format);
+ vsnprintf(error, error_len, format, args);
+ va_end(args);
+ return -1;
+}
+
+// Validate the headers of a mapped image against the mapping size
+static int pe_parse(PeImage *pe) {
+ if (pe->size < sizeof(DosHeader)) {
+  return pe_fail(pe, "is too small to be a PE file");
+ }
+ pe->dos = (DosHeader *)pe->base;
+ if (pe->dos->e_magic != DOS_SIGNATURE) {
+  return pe_fail(pe, "is not a valid PE file (missing MZ signature)");
  }
 
- FILE *target = fopen(target_file, "r+b");
- if (!target) {
-  perror("Error opening target file");
-  fclose(source);
-  return;
+ uint64_t nt_off = (uint32_t)pe->dos->e_lfanew;
+ if (pe->dos->e_lfanew < 0 || nt_off + 4 + sizeof(CoffHeader) > pe->size) {
+  return pe_fail(pe, "has an NT header offset outside the file");
+ }
+ uint32_t signature;
+ memcpy(&signature, pe->base + nt_off, 4);
+ if (signature != NT_SIGNATURE) {
+  return pe_fail(pe, "has invalid PE signature");
  }
+ pe->nt_off = nt_off;
+ pe->coff = (CoffHeader *)(pe->base + nt_off + 4);
 
- // Read and validate source DOS header
- IMAGE_DOS_HEADER srcDosHeader;
- if (fread(&srcDosHeader, sizeof(IMAGE_DOS_HEADER), 1, source) != 1) {
-  printf("Error reading source DOS header\n");
-  goto cleanup;
+ // The optional header size comes from the COFF header, PE32+ images have a larger one
+ uint64_t opt_off = nt_off + 4 + sizeof(CoffHeader);
+ uint16_t opt_size = pe->coff->SizeOfOptionalHeader;
+ if (opt_size < offsetof(OptionalHeader32, DataDirectory) || opt_off + opt_size > pe->size) {
+  return pe_fail(pe, "has a truncated optional header");
  }
- if (srcDosHeader.e_magic != IMAGE_DOS_SIGNATURE) {
-  printf("Source file is not a valid PE file (missing MZ signature)\n");
-  goto cleanup;
+ pe->opt = pe->base + opt_off;
+ pe->nt_len = 4 + sizeof(CoffHeader) + opt_size;
+
+ size_t dir_off;
+ uint32_t dir_count;
+ uint16_t magic;
+ memcpy(&magic, pe->opt, 2);
+ if (magic == OPT_MAGIC_PE32) {
+  OptionalHeader32 *opt = (OptionalHeader32 *)pe->opt;
+  pe->pe32plus = 0;
+  pe->size_of_headers = opt->SizeOfHeaders;
+  dir_off = offsetof(OptionalHeader32, DataDirectory);
+  dir_count = opt->NumberOfRvaAndSizes;
+ } else if (magic == OPT_MAGIC_PE32PLUS) {
+  if (opt_size < offsetof(OptionalHeader64, DataDirectory)) {
+   return pe_fail(pe, "has a truncated PE32+ optional header");
+  }
+  OptionalHeader64 *opt = (OptionalHeader64 *)pe->opt;
+  pe->pe32plus = 1;
+  pe->size_of_headers = opt->SizeOfHeaders;
+  dir_off = offsetof(OptionalHeader64, DataDirectory);
+  dir_count = opt->NumberOfRvaAndSizes;
+ } else {
+  return pe_fail(pe, "has an unknown optional header magic 0x%x", magic);
  }
+ if (dir_count > NUMBEROF_DIRECTORY_ENTRIES) dir_count = NUMBEROF_DIRECTORY_ENTRIES;
+ if (dir_count > (opt_size - dir_off) / sizeof(DataDirectory)) dir_count = (opt_size - dir_off) / sizeof(DataDirectory);
+ pe->dirs = (DataDirectory *)(pe->opt + dir_off);
+ pe->dir_count = dir_count;
 
- // Read and validate target DOS header
- IMAGE_DOS_HEADER tgtDosHeader;
- if (fread(&tgtDosHeader, sizeof(IMAGE_DOS_HEADER), 1, target) != 1) {
-  printf("Error reading target DOS header\n");
-  goto cleanup;
+ uint64_t sec_off = opt_off + opt_size;
+ pe->section_count = pe->coff->NumberOfSections;
+ if (sec_off + (uint64_t)pe->section_count * sizeof(SectionHeader) > pe->size) {
+  return pe_fail(pe, "has a section table outside the file");
  }
- if (tgtDosHeader.e_magic != IMAGE_DOS_SIGNATURE) {
-  printf("Target file is not a valid PE file (missing MZ signature)\n");
-  goto cleanup;
+ pe->sections = (SectionHeader *)(pe->base + sec_off);
+ return 0;
+}
+
+// Map a PE file, read only for sources and shared writable for targets
+static int pe_open(PeImage *pe, const char *path, int writable) {
+ memset(pe, 0, sizeof(*pe));
+ pe->path = path;
+ pe->fd = open(path, writable ? O_RDWR : O_RDONLY);
+ if (pe->fd < 0) return pe_fail(pe, "cannot be opened (%s)", strerror(errno));
+ struct stat st;
+ if (fstat(pe->fd, &st) != 0 || st.st_size == 0) {
+  close(pe->fd);
+  return pe_fail(pe, "is empty or unreadable");
  }
+ pe->size = st.st_size;
+ pe->base = mmap(NULL, pe->size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, pe->fd, 0);
+ if (pe->base == MAP_FAILED) {
+  close(pe->fd);
+  return pe_fail(pe, "cannot be mapped (%s)", strerror(errno));
+ }
+ if (pe_parse(pe) != 0) {
+  munmap(pe->base, pe->size);
+  close(pe->fd);
+  return -1;
+ }
+ return 0;
+}
 
- // Read source NT headers
- fseek(source, srcDosHeader.e_lfanew, SEEK_SET);
- IMAGE_NT_HEADERS srcNtHeaders;
- if (fread(&srcNtHeaders, sizeof(IMAGE_NT_HEADERS), 1, source) != 1) {
-  printf("Error reading source NT headers\n");
-  goto cleanup;
+static void pe_close(PeImage *pe) {
+ munmap(pe->base, pe->size);
+ close(pe->fd);
+}
+
+static DataDirectory *pe_resource_dir(const PeImage *pe) {
+ return pe->dir_count > DIRECTORY_ENTRY_RESOURCE ? &pe->dirs[DIRECTORY_ENTRY_RESOURCE] : NULL;
+}
+
+static int compare_by_rva(const void *a, const void *b) {
+ uint32_t va = ((const SectionHeader *)a)->VirtualAddress, vb = ((const SectionHeader *)b)->VirtualAddress;
+ return va < vb ? -1 : va > vb;
+}
+
+// Copy of a section table sorted by VirtualAddress, for rva_to_offset lookups
+static SectionHeader *section_index(const SectionHeader *sections, int count) {
+ SectionHeader *index = malloc((count ? count : 1) * sizeof(SectionHeader));
+ if (!index) return NULL;
+ memcpy(index, sections, count * sizeof(SectionHeader));
+ qsort(index, count, sizeof(SectionHeader), compare_by_rva);
+ return index;
+}
+
+// Translate an RVA to a file offset with a binary search in a section index, 0 if it is not backed by the file
+static uint64_t rva_to_offset(const SectionHeader *index, int count, uint32_t rva) {
+ int lo = 0, hi = count - 1, found = -1;
+ while (lo <= hi) {
+  int mid = lo + (hi - lo) / 2;
+  if (index[mid].VirtualAddress <= rva) {
+   found = mid;
+   lo = mid + 1;
+  } else {
+   hi = mid - 1;
+  }
  }
- if (srcNtHeaders.Signature != IMAGE_NT_SIGNATURE) {
-  printf("Source file has invalid PE signature\n");
-  goto cleanup;
+ if (found < 0) return 0;
+ const SectionHeader *sec = &index[found];
+ uint32_t span = sec->VirtualSize > sec->SizeOfRawData ? sec->VirtualSize : sec->SizeOfRawData;
+ uint32_t delta = rva - sec->VirtualAddress;
+ if (delta >= span || delta >= sec->SizeOfRawData) return 0;
+ return (uint64_t)sec->PointerToRawData + delta;
+}
+
+// Walk one resource directory, dir is relative to the start of the resource section
+static void resource_walk(const unsigned char *base, size_t size, const SectionHeader *index, int count,
+        uint64_t res_off, uint64_t res_size, uint32_t dir, int depth, uint32_t type, ResourceStats *stats) {
+ if (depth >= RESOURCE_MAX_DEPTH || (uint64_t)dir + sizeof(ResourceDirectory) > res_size) return;
+ const ResourceDirectory *rd = (const ResourceDirectory *)(base + res_off + dir);
+ uint64_t entry_count = (uint64_t)rd->NumberOfNamedEntries + rd->NumberOfIdEntries;
+ if (dir + sizeof(ResourceDirectory) + entry_count * sizeof(ResourceDirectoryEntry) > res_size) {
+  stats->invalid++;
+  return;
  }
+ const ResourceDirectoryEntry *entries = (const ResourceDirectoryEntry *)(rd + 1);
 
- // Read target NT headers
- fseek(target, tgtDosHeader.e_lfanew, SEEK_SET);
- IMAGE_NT_HEADERS tgtNtHeaders;
- if (fread(&tgtNtHeaders, sizeof(IMAGE_NT_HEADERS), 1, target) != 1) {
-  printf("Error reading target NT headers\n");
-  goto cleanup;
+ for (uint64_t i = 0; i < entry_count; i++) {
+  // Subdirectories may be shared or point back at their parent, so the budget covers every visit
+  if (++stats->entries > RESOURCE_MAX_ENTRIES) return;
+  uint32_t entry_type = type;
+  if (depth == 0) {
+   stats->types++;
+   entry_type = (entries[i].Name & 0x80000000) ? 0 : (entries[i].Name & 0xFFFF);
+  }
+  uint32_t target = entries[i].OffsetToData & 0x7FFFFFFF;
+  if (entries[i].OffsetToData & 0x80000000) {
+   resource_walk(base, size, index, count, res_off, res_size, target, depth + 1, entry_type, stats);
+   continue;
+  }
+  // Leaf: a data entry pointing at the resource bytes by RVA
+  if ((uint64_t)target + sizeof(ResourceDataEntry) > res_size) {
+   stats->invalid++;
+   continue;
+  }
+  const ResourceDataEntry *data = (const ResourceDataEntry *)(base + res_off + target);
+  uint64_t data_off = rva_to_offset(index, count, data->OffsetToData);
+  stats->leaves++;
+  if (!data_off || data_off + data->Size > size) stats->invalid++;
+  if (entry_type == RT_ICON) stats->icons++;
+  if (entry_type == RT_GROUP_ICON) stats->group_icons++;
  }
- if (tgtNtHeaders.Signature != IMAGE_NT_SIGNATURE) {
-  printf("Target file has invalid PE signature\n");
-  goto cleanup;
+}
+
+// Summarize the full resource tree of an image described by a sorted section index.
+// Returns -1 when there is no resource directory and -2 when the tree is malformed.
+static int resource_stats(const unsigned char *base, size_t size, const SectionHeader *index, int count,
+        DataDirectory res, ResourceStats *stats) {
+ memset(stats, 0, sizeof(*stats));
+ if (!res.VirtualAddress || !res.Size) return -1;
+ uint64_t res_off = rva_to_offset(index, count, res.VirtualAddress);
+ if (!res_off || res_off >= size) return -1;
+ uint64_t res_size = res.Size < size - res_off ? res.Size : size - res_off;
+ resource_walk(base, size, index, count, res_off, res_size, 0, 0, 0, stats);
+ return stats->entries > RESOURCE_MAX_ENTRIES ? -2 : 0;
+}
+
+// Sum of the little endian 16-bit words of buf, carries are folded by the caller.
+// SSE2 widens 8 words per load into four 32-bit lanes, flushed to 64 bits before they can overflow.
+static uint64_t sum_words(const unsigned char *p, size_t len) {
+ uint64_t sum = 0;
+ size_t i = 0;
+#ifdef __SSE2__
+ const __m128i zero = _mm_setzero_si128();
+ while (len - i >= 16) {
+  size_t blocks = (len - i) / 16;
+  if (blocks > 16384) blocks = 16384;  // each lane grows by at most 2 * 0xFFFF per block
+  __m128i acc = zero;
+  for (size_t b = 0; b < blocks; b++, i += 16) {
+   __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+   acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+   acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+  }
+  uint32_t lanes[4];
+  _mm_storeu_si128((__m128i *)lanes, acc);
+  sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
  }
+#endif
+ for (; i + 1 < len; i += 2) sum += p[i] | (p[i + 1] << 8);
+ if (i < len) sum += p[i];  // odd trailing byte
+ return sum;
+}
 
- // Save target's resource directory
- IMAGE_DATA_DIRECTORY tgtResourceDir = tgtNtHeaders.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_RESOURCE];
+// PE image checksum: 16-bit one's complement style sum of the file with the CheckSum
+// field counted as zero, plus the file length
+static uint32_t pe_checksum(const PeImage *pe) {
+ size_t field = (size_t)(pe->opt - pe->base) + CHECKSUM_OFFSET;
+ uint64_t sum = sum_words(pe->base, pe->size);
+ for (int i = 0; i < 4; i++) {
+  size_t pos = field + i;
+  sum -= (pos & 1) ? (uint64_t)pe->base[pos] << 8 : pe->base[pos];
+ }
+ while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+ return (uint32_t)sum + (uint32_t)pe->size;
+}
 
- // Write source DOS header
- fseek(target, 0, SEEK_SET);
- if (fwrite(&srcDosHeader, sizeof(IMAGE_DOS_HEADER), 1, target) != 1) {
-  printf("Error writing DOS header to target\n");
-  goto cleanup;
+// Apply an already parsed source header to one target, returns 0 when the header was transferred.
+// Messages name the target display_name (target_file may be a staging copy), failures go to error.
+int transfer_pe_header(const PeImage *srcp, const char *target_file, const char *display_name, int copy_sections,
+        char *error, size_t error_len) {
+ PeImage src = *srcp, tgt;
+ const char *source_file = src.path;
+ int status = -1;
+
+ if (pe_open(&tgt, target_file, 1) != 0) {
+  return set_error(error, error_len, "%s", pe_reason(&tgt));
  }
 
- // Write source NT headers
- fseek(target, srcDosHeader.e_lfanew, SEEK_SET);
- if (fwrite(&srcNtHeaders, sizeof(IMAGE_NT_HEADERS), 1, target) != 1) {
-  printf("Error writing NT headers to target\n");
+ // Everything written must stay inside the target's header area, before its section data
+ uint64_t write_end = (uint64_t)src.nt_off + src.nt_len;
+ if (copy_sections) write_end += (uint64_t)src.section_count * sizeof(SectionHeader);
+ uint64_t header_limit = tgt.size_of_headers && tgt.size_of_headers < tgt.size ? tgt.size_of_headers : tgt.size;
+ if (write_end > header_limit) {
+  set_error(error, error_len, "source headers (%llu bytes) do not fit in the target header area (%llu bytes)",
+    (unsigned long long)write_end, (unsigned long long)header_limit);
   goto cleanup;
  }
 
- // Restore target's resource directory
- fseek(target, srcDosHeader.e_lfanew + offsetof(IMAGE_NT_HEADERS, OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_RESOURCE]), SEEK_SET);
- if (fwrite(&tgtResourceDir, sizeof(IMAGE_DATA_DIRECTORY), 1, target) != 1) {
-  printf("Error restoring resource directory\n");
+ // Save what the transfer overwrites: the target's resource directory and section table
+ DataDirectory *tgt_res = pe_resource_dir(&tgt);
+ DataDirectory tgtResourceDir = tgt_res ? *tgt_res : (DataDirectory){0, 0};
+ int tgtSectionCount = tgt.section_count;
+ SectionHeader *tgtSections = malloc((tgtSectionCount ? tgtSectionCount : 1) * sizeof(SectionHeader));
+ if (!tgtSections) {
+  set_error(error, error_len, "memory allocation failed for target sections");
   goto cleanup;
  }
+ memcpy(tgtSections, tgt.sections, tgtSectionCount * sizeof(SectionHeader));
 
- // Handle section table if requested
- if (copy_sections) {
-  int srcSectionCount = srcNtHeaders.FileHeader.NumberOfSections;
-  IMAGE_SECTION_HEADER *srcSections = malloc(srcSectionCount * sizeof(IMAGE_SECTION_HEADER));
-  if (!srcSections) {
-   printf("Memory allocation failed for source sections\n");
+ // Icon verification before anything is written, the resource tree is walked through the target's own sections
+ if (tgtResourceDir.VirtualAddress && tgtResourceDir.Size) {
+  ResourceStats stats;
+  qsort(tgtSections, tgtSectionCount, sizeof(SectionHeader), compare_by_rva);
+  int found = resource_stats(tgt.base, tgt.size, tgtSections, tgtSectionCount, tgtResourceDir, &stats);
+  if (found == -2) {
+   set_error(error, error_len, "has a malformed resource directory");
+   free(tgtSections);
    goto cleanup;
   }
-  fseek(source, srcDosHeader.e_lfanew + sizeof(IMAGE_NT_HEADERS), SEEK_SET);
-  if (fread(srcSections, sizeof(IMAGE_SECTION_HEADER), srcSectionCount, source) != srcSectionCount) {
-   printf("Error reading source section table\n");
-   free(srcSections);
-   goto cleanup;
+  if (found == 0 && stats.icons) {
+   printf("Icon resource detected in %s (%d icons, %d icon groups)\n", display_name, stats.icons, stats.group_icons);
   }
+ } else {
+  printf("No resource directory found in %s\n", display_name);
+ }
 
-  int tgtSectionCount = tgtNtHeaders.FileHeader.NumberOfSections;
-  IMAGE_SECTION_HEADER *tgtSections = malloc(tgtSectionCount * sizeof(IMAGE_SECTION_HEADER));
-  if (!tgtSections) {
-   printf("Memory allocation failed for target sections\n");
-   free(srcSections);
-   goto cleanup;
-  }
-  fseek(target, tgtDosHeader.e_lfanew + sizeof(IMAGE_NT_HEADERS), SEEK_SET);
-  if (fread(tgtSections, sizeof(IMAGE_SECTION_HEADER), tgtSectionCount, target) != tgtSectionCount) {
-   printf("Error reading target section table\n");
-   free(srcSections);
-   free(tgtSections);
-   goto cleanup;
-  }
+ // DOS header then NT headers, copied straight between the two mappings
+ memcpy(tgt.base, src.base, sizeof(DosHeader));
+ memcpy(tgt.base + src.nt_off, src.base + src.nt_off, src.nt_len);
 
-  IMAGE_SECTION_HEADER *tgtRsrcSection = NULL;
+ // Restore target's resource directory, at its position in the source layout
+ if (pe_parse(&tgt) != 0) {
+  set_error(error, error_len, "cannot re-read target headers after transfer: %s", pe_reason(&tgt));
+  free(tgtSections);
+  goto cleanup;
+ }
+ DataDirectory *new_res = pe_resource_dir(&tgt);
+ if (new_res) {
+  *new_res = tgtResourceDir;
+ } else if (tgtResourceDir.Size) {
+  printf("Warning: source optional header has no resource directory slot, resources of %s dropped\n", display_name);
+ }
+
+ // Handle section table if requested
+ if (copy_sections) {
+  SectionHeader *tgtRsrcSection = NULL;
   for (int i = 0; i < tgtSectionCount; i++) {
    if (strncmp((char *)tgtSections[i].Name, ".rsrc", 5) == 0) {
     tgtRsrcSection = &tgtSections[i];
@@ -130,82 +548,462 @@ void copy_pe_header_with_resources(const char *source_file, const char *target_f
    }
   }
   if (!tgtRsrcSection) {
-   printf("Warning: Target file has no .rsrc section\n");
-  }
-
-  fseek(target, srcDosHeader.e_lfanew + sizeof(IMAGE_NT_HEADERS), SEEK_SET);
-  for (int i = 0; i < srcSectionCount; i++) {
-   if (tgtRsrcSection && strncmp((char *)srcSections[i].Name, ".rsrc", 5) == 0) {
-    if (fwrite(tgtRsrcSection, sizeof(IMAGE_SECTION_HEADER), 1, target) != 1) {
-     printf("Error writing .rsrc section header\n");
-     free(srcSections);
-     free(tgtSections);
-     goto cleanup;
-    }
+   printf("Warning: %s has no .rsrc section\n", display_name);
+  }
+
+  for (int i = 0; i < src.section_count; i++) {
+   if (tgtRsrcSection && strncmp((char *)src.sections[i].Name, ".rsrc", 5) == 0) {
+    tgt.sections[i] = *tgtRsrcSection;
    } else {
-    if (fwrite(&srcSections[i], sizeof(IMAGE_SECTION_HEADER), 1, target) != 1) {
-     printf("Error writing section header %d\n", i);
-     free(srcSections);
-     free(tgtSections);
-     goto cleanup;
-    }
+    tgt.sections[i] = src.sections[i];
    }
   }
-  free(srcSections);
-  free(tgtSections);
  }
 
- // Icon verification
- if (tgtResourceDir.VirtualAddress && tgtResourceDir.Size) {
-  fseek(target, tgtNtHeaders.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_RESOURCE].VirtualAddress - tgtNtHeaders.OptionalHeader.ImageBase + tgtDosHeader.e_lfanew, SEEK_SET);
-  IMAGE_RESOURCE_DIRECTORY resDir;
-  if (fread(&resDir, sizeof(IMAGE_RESOURCE_DIRECTORY), 1, target) == 1) {
-   int entryCount = resDir.NumberOfNamedEntries + resDir.NumberOfIdEntries;
-   fseek(target, -sizeof(IMAGE_RESOURCE_DIRECTORY), SEEK_CUR); // Rewind to start of directory
-   fseek(target, sizeof(IMAGE_RESOURCE_DIRECTORY), SEEK_CUR);  // Skip to entries
-   for (int i = 0; i < entryCount; i++) {
-    IMAGE_RESOURCE_DIRECTORY_ENTRY entry;
-    if (fread(&entry, sizeof(IMAGE_RESOURCE_DIRECTORY_ENTRY), 1, target) != 1) break;
-    if (!entry.NameIsString && entry.Id == 3) { // RT_ICON = 3
-     printf("Icon resource detected in target file\n");
-     break;
-    }
+ free(tgtSections);
+
+ // The copied optional header carries the source's CheckSum, which is wrong for this image
+ if (fix_checksum) {
+  uint32_t old_sum, new_sum = pe_checksum(&tgt);
+  memcpy(&old_sum, tgt.opt + CHECKSUM_OFFSET, 4);
+  memcpy(tgt.opt + CHECKSUM_OFFSET, &new_sum, 4);
+  printf("Checksum of %s updated: 0x%08X (was 0x%08X)\n", display_name, new_sum, old_sum);
+ }
+
+ printf("PE header %s from %s to %s, preserving target's resources\n",
+     copy_sections ? "and section table copied" : "copied", source_file, display_name);
+ status = 0;
+
+cleanup:
+ pe_close(&tgt);
+ return status;
+}
+
+int copy_pe_header_with_resources(const char *source_file, const char *target_file, int copy_sections) {
+ PeImage src;
+ if (pe_open(&src, source_file, 0) != 0) {
+  printf("Error: %s\n", src.error);
+  return -1;
+ }
+ char error[MAX_PATH + 128];
+ int status = transfer_pe_header(&src, target_file, target_file, copy_sections, error, sizeof(error));
+ if (status != 0) printf("Error: %s: %s\n", target_file, error);
+ pe_close(&src);
+ return status;
+}
+
+// Batch mode: targets are patched on a staged copy that replaces the original with rename()
+typedef struct {
+ char *path;
+ int status;
+ char error[256];
+} BatchTarget;
+
+struct {
+ PeImage src;
+ dev_t src_dev;
+ ino_t src_ino;
+ int copy_sections;
+ BatchTarget *targets;
+ size_t count, cap, next;
+ void (*process)(BatchTarget *);
+ pthread_mutex_t lock;
+ pthread_mutex_t output_lock;
+} batch = {.lock = PTHREAD_MUTEX_INITIALIZER, .output_lock = PTHREAD_MUTEX_INITIALIZER};
+
+static int batch_add(const char *path) {
+ if (batch.count == batch.cap) {
+  size_t cap = batch.cap ? batch.cap * 2 : 64;
+  BatchTarget *targets = realloc(batch.targets, cap * sizeof(BatchTarget));
+  if (!targets) return -1;
+  batch.targets = targets;
+  batch.cap = cap;
+ }
+ batch.targets[batch.count].path = strdup(path);
+ if (!batch.targets[batch.count].path) return -1;
+ batch.targets[batch.count].status = -1;
+ batch.targets[batch.count].error[0] = '\0';
+ batch.count++;
+ return 0;
+}
+
+static int has_pe_extension(const char *name) {
+ static const char *pe_ext[] = {"exe", "dll", "sys", "ocx", "scr", "cpl", "efi", NULL};
+ const char *dot = strrchr(name, '.');
+ if (!dot) return 0;
+ for (int i = 0; pe_ext[i]; i++) {
+  if (strcasecmp(dot + 1, pe_ext[i]) == 0) return 1;
+ }
+ return 0;
+}
+
+// Targets from a list file (one path per line, # comments) or the PE files of a directory
+static int batch_load_targets(const char *spec) {
+ struct stat st;
+ if (stat(spec, &st) != 0) {
+  printf("Error: cannot access %s: %s\n", spec, strerror(errno));
+  return -1;
+ }
+
+ if (S_ISDIR(st.st_mode)) {
+  DIR *dir = opendir(spec);
+  if (!dir) {
+   printf("Error: cannot open directory %s: %s\n", spec, strerror(errno));
+   return -1;
+  }
+  struct dirent *entry;
+  char path[MAX_PATH];
+  while ((entry = readdir(dir)) != NULL) {
+   if (!has_pe_extension(entry->d_name)) continue;
+   snprintf(path, MAX_PATH, "%s/%s", spec, entry->d_name);
+   if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+   if (batch_add(path) != 0) {
+    closedir(dir);
+    return -1;
    }
   }
+  closedir(dir);
+  return 0;
+ }
+
+ FILE *list = fopen(spec, "r");
+ if (!list) {
+  printf("Error: cannot open target list %s: %s\n", spec, strerror(errno));
+  return -1;
+ }
+ char line[MAX_PATH];
+ while (fgets(line, sizeof(line), list)) {
+  line[strcspn(line, "\r\n")] = '\0';
+  if (line[0] == '\0' || line[0] == '#') continue;
+  if (batch_add(line) != 0) {
+   fclose(list);
+   return -1;
+  }
+ }
+ fclose(list);
+ return 0;
+}
+
+// Copy a whole file into fd, copy_file_range lets the kernel (or a reflink) do the work
+static int copy_contents(int in, int out, off_t size) {
+ off_t done = 0;
+ while (done < size) {
+  ssize_t n = copy_file_range(in, NULL, out, NULL, size - done, 0);
+  if (n <= 0) break;
+  done += n;
+ }
+ if (done == size) return 0;
+
+ // Fallback for filesystems without copy_file_range
+ char buf[65536];
+ if (lseek(in, done, SEEK_SET) < 0 || lseek(out, done, SEEK_SET) < 0) return -1;
+ ssize_t n;
+ while ((n = read(in, buf, sizeof(buf))) > 0) {
+  if (write(out, buf, n) != n) return -1;
+ }
+ return n < 0 ? -1 : 0;
+}
+
+static void batch_process(BatchTarget *t) {
+ struct stat st;
+ if (stat(t->path, &st) != 0 || !S_ISREG(st.st_mode)) {
+  set_error(t->error, sizeof(t->error), "not a regular file");
+  return;
+ }
+ if (st.st_dev == batch.src_dev && st.st_ino == batch.src_ino) {
+  set_error(t->error, sizeof(t->error), "same file as source");
+  return;
+ }
+
+ // Stage in the same directory so that rename() stays atomic
+ char tmp[MAX_PATH];
+ if (snprintf(tmp, MAX_PATH, "%s.XXXXXX", t->path) >= MAX_PATH) {
+  set_error(t->error, sizeof(t->error), "path too long");
+  return;
+ }
+ int out = mkstemp(tmp);
+ if (out < 0) {
+  set_error(t->error, sizeof(t->error), "cannot create staging file");
+  return;
+ }
+ int in = open(t->path, O_RDONLY);
+ if (in < 0 || copy_contents(in, out, st.st_size) != 0 || fchmod(out, st.st_mode & 07777) != 0) {
+  set_error(t->error, sizeof(t->error), "cannot stage target");
+  if (in >= 0) close(in);
+  close(out);
+  unlink(tmp);
+  return;
+ }
+ close(in);
+
+ if (transfer_pe_header(&batch.src, tmp, t->path, batch.copy_sections, t->error, sizeof(t->error)) != 0) {
+  close(out);
+  unlink(tmp);
+  return;
+ }
+ if (fsync(out) != 0 || rename(tmp, t->path) != 0) {
+  set_error(t->error, sizeof(t->error), "cannot commit target");
+  close(out);
+  unlink(tmp);
+  return;
+ }
+ close(out);
+ t->status = 0;
+}
+
+static void *batch_worker(void *arg) {
+ (void)arg;
+ for (;;) {
+  pthread_mutex_lock(&batch.lock);
+  size_t i = batch.next++;
+  pthread_mutex_unlock(&batch.lock);
+  if (i >= batch.count) break;
+  batch.process(&batch.targets[i]);
+ }
+ return NULL;
+}
+
+// Run batch.process over every target on jobs threads
+static void batch_run(int jobs) {
+ if (jobs > (int)batch.count) jobs = batch.count;
+ pthread_t *workers = calloc(jobs, sizeof(pthread_t));
+ int started = 0;
+ for (int i = 0; workers && i < jobs; i++) {
+  if (pthread_create(&workers[i], NULL, batch_worker, NULL) != 0) break;
+  started++;
+ }
+ if (started == 0) batch_worker(NULL);
+ for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+ free(workers);
+}
+
+// Parse the source once, then patch every target on a pool of jobs threads
+int batch_transfer(const char *source_file, const char *targets_spec, int copy_sections, int jobs) {
+ if (pe_open(&batch.src, source_file, 0) != 0) {
+  printf("Error: %s\n", batch.src.error);
+  return -1;
+ }
+ struct stat st;
+ fstat(batch.src.fd, &st);
+ batch.src_dev = st.st_dev;
+ batch.src_ino = st.st_ino;
+ batch.copy_sections = copy_sections;
+
+ if (batch_load_targets(targets_spec) != 0) {
+  pe_close(&batch.src);
+  return -1;
+ }
+ if (batch.count == 0) {
+  printf("No target found in %s\n", targets_spec);
+  pe_close(&batch.src);
+  return -1;
+ }
+
+ batch.process = batch_process;
+ batch_run(jobs);
+ pe_close(&batch.src);
+
+ // Per target summary
+ size_t ok = 0;
+ printf("\nSummary (%s -> %zu targets):\n", source_file, batch.count);
+ for (size_t i = 0; i < batch.count; i++) {
+  BatchTarget *t = &batch.targets[i];
+  if (t->status == 0) {
+   ok++;
+   printf("  OK      %s\n", t->path);
+  } else {
+   printf("  FAILED  %s (%s)\n", t->path, t->error[0] ? t->error : "unknown error");
+  }
+  free(t->path);
+ }
+ printf("%zu transferred, %zu failed\n", ok, batch.count - ok);
+ free(batch.targets);
+ return ok == batch.count ? 0 : -1;
+}
+
+// Inspect mode: collect executables recursively, then emit one JSON object per line
+static int inspect_collect(const char *path) {
+ struct stat st;
+ if (stat(path, &st) != 0) return batch_add(path);  // reported as an error line
+ if (!S_ISDIR(st.st_mode)) return batch_add(path);
+
+ DIR *dir = opendir(path);
+ if (!dir) return batch_add(path);
+ struct dirent *entry;
+ char full_path[MAX_PATH];
+ while ((entry = readdir(dir)) != NULL) {
+  if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+  if (snprintf(full_path, MAX_PATH, "%s/%s", path, entry->d_name) >= MAX_PATH) continue;
+  if (stat(full_path, &st) != 0) continue;
+  if (S_ISDIR(st.st_mode)) {
+   if (inspect_collect(full_path) != 0) break;
+  } else if (S_ISREG(st.st_mode) && has_pe_extension(entry->d_name)) {
+   if (batch_add(full_path) != 0) break;
+  }
+ }
+ closedir(dir);
+ return 0;
+}
+
+// JSON is UTF-8: bytes from 0x80 up are copied as is, only quotes, backslashes and controls are escaped
+static void json_string(FILE *out, const char *str, size_t max) {
+ fputc('"', out);
+ for (size_t i = 0; i < max && str[i]; i++) {
+  unsigned char c = str[i];
+  if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+  else if (c < 0x20) fprintf(out, "\\u%04x", c);
+  else fputc(c, out);
+ }
+ fputc('"', out);
+}
+
+static void inspect_file(BatchTarget *t) {
+ char *json = NULL;
+ size_t json_len = 0;
+ FILE *out = open_memstream(&json, &json_len);
+ if (!out) return;
+
+ PeImage pe;
+ fputs("{\"file\":", out);
+ json_string(out, t->path, MAX_PATH);
+ if (pe_open(&pe, t->path, 0) != 0) {
+  fputs(",\"error\":", out);
+  json_string(out, pe_reason(&pe), sizeof(pe.error));
+  set_error(t->error, sizeof(t->error), "invalid");
  } else {
-  printf("No resource directory found in target\n");
+  SectionHeader *index = section_index(pe.sections, pe.section_count);
+  uint32_t stored;
+  memcpy(&stored, pe.opt + CHECKSUM_OFFSET, 4);
+  fprintf(out, ",\"format\":\"%s\",\"machine\":\"0x%04x\",\"timestamp\":%u,\"size\":%zu",
+    pe.pe32plus ? "PE32+" : "PE32", pe.coff->Machine, pe.coff->TimeDateStamp, pe.size);
+  fprintf(out, ",\"checksum\":{\"stored\":%u,\"computed\":%u}", stored, pe_checksum(&pe));
+
+  fputs(",\"sections\":[", out);
+  for (int i = 0; i < pe.section_count; i++) {
+   const SectionHeader *sec = &pe.sections[i];
+   fprintf(out, "%s{\"name\":", i ? "," : "");
+   json_string(out, (const char *)sec->Name, sizeof(sec->Name));
+   fprintf(out, ",\"va\":%u,\"vsize\":%u,\"raw\":%u,\"rawsize\":%u}",
+     sec->VirtualAddress, sec->VirtualSize, sec->PointerToRawData, sec->SizeOfRawData);
+  }
+  fputc(']', out);
+
+  DataDirectory *res = pe_resource_dir(&pe);
+  ResourceStats stats;
+  int found = index && res ? resource_stats(pe.base, pe.size, index, pe.section_count, *res, &stats) : -1;
+  if (found == 0) {
+   fprintf(out, ",\"resources\":{\"types\":%d,\"leaves\":%d,\"icons\":%d,\"group_icons\":%d,\"invalid\":%d}",
+     stats.types, stats.leaves, stats.icons, stats.group_icons, stats.invalid);
+  } else {
+   fputs(",\"resources\":null", out);
+  }
+  free(index);
+  pe_close(&pe);
+  if (found == -2) {
+   fputs(",\"error\":\"malformed resource directory\"", out);
+   set_error(t->error, sizeof(t->error), "invalid");
+  } else {
+   t->status = 0;
+  }
  }
+ fputs("}\n", out);
+ fclose(out);
 
- printf("PE header %s from %s to %s, preserving target's resources\n", 
-     copy_sections ? "and section table copied" : "copied", source_file, target_file);
+ pthread_mutex_lock(&batch.output_lock);
+ fwrite(json, 1, json_len, stdout);
+ pthread_mutex_unlock(&batch.output_lock);
+ free(json);
+}
 
-cleanup:
- fclose(source);
- fclose(target);
+int inspect(char **paths, int count, int jobs) {
+ for (int i = 0; i < count; i++) {
+  if (inspect_collect(paths[i]) != 0) {
+   printf("Error: memory allocation failed while collecting files\n");
+   return -1;
+  }
+ }
+ batch.process = inspect_file;
+ batch_run(jobs);
+
+ int failed = 0;
+ for (size_t i = 0; i < batch.count; i++) {
+  if (batch.targets[i].status != 0) failed++;
+  free(batch.targets[i].path);
+ }
+ free(batch.targets);
+ return failed ? -1 : 0;
+}
+
+void usage(const char *prog) {
+ printf("Usage: %s [-s] [-c] <source_file> <target_file>\n", prog);
+ printf("       %s [-s] [-c] [-j N] <source_file> --targets <list.txt|directory>\n", prog);
+ printf("  -s: Copy section table (optional)\n");
+ printf("  -c: Recompute the target's PE checksum after the transfer (optional)\n");
+ printf("  -j: Number of worker threads for --targets (default: number of cores)\n");
+ printf("       %s --inspect [-j N] <file|directory>...\n", prog);
+ printf("  --targets: File listing one target per line, or directory of .exe/.dll/.sys files\n");
+ printf("  --inspect: Print one JSON line per executable (sections, checksum, resource tree)\n");
+ printf("Example: %s source.exe target.exe\n", prog);
+ printf("   %s -s source.exe target.exe\n", prog);
+ printf("   %s source.exe --targets build/bin\n", prog);
 }
 
 int main(int argc, char *argv[]) {
  int copy_sections = 0;
+ int jobs = 0;
+ char *targets = NULL;
+ int inspect_mode = 0;
+ char **files = calloc(argc, sizeof(char *));
+ int file_count = 0;
+ if (!files) return 1;
 
- if (argc < 3 || argc > 4) {
-  printf("Usage: %s [-s] <source_file> <target_file>\n", argv[0]);
-  printf("  -s: Copy section table (optional)\n");
-  printf("Example: %s source.exe target.exe\n", argv[0]);
-  printf("   %s -s source.exe target.exe\n", argv[0]);
-  return 1;
- }
-
- if (argc == 4) {
-  if (strcmp(argv[1], "-s") == 0) {
+ for (int i = 1; i < argc; i++) {
+  if (strcmp(argv[i], "-s") == 0) {
    copy_sections = 1;
-   copy_pe_header_with_resources(argv[2], argv[3], copy_sections);
+  } else if (strcmp(argv[i], "-c") == 0) {
+   fix_checksum = 1;
+  } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+   jobs = atoi(argv[++i]);
+   if (jobs < 1) {
+    printf("Invalid -j value, it must be a positive number.\n");
+    return 1;
+   }
+  } else if (strcmp(argv[i], "--targets") == 0 && i + 1 < argc) {
+   targets = argv[++i];
+  } else if (strcmp(argv[i], "--inspect") == 0) {
+   inspect_mode = 1;
+  } else if (argv[i][0] == '-') {
+   printf("Invalid flag %s. Use -s to copy section table.\n", argv[i]);
+   return 1;
   } else {
-   printf("Invalid flag. Use -s to copy section table.\n");
+   files[file_count++] = argv[i];
+  }
+ }
+
+ if (!jobs) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  jobs = cpus > 0 ? (int)cpus : 1;
+ }
+
+ if (inspect_mode) {
+  if (file_count == 0 || targets) {
+   usage(argv[0]);
    return 1;
   }
- } else {
-  copy_pe_header_with_resources(argv[1], argv[2], copy_sections);
+  return inspect(files, file_count, jobs) == 0 ? 0 : 1;
  }
 
- return 0;
+ if (targets) {
+  if (file_count != 1) {
+   usage(argv[0]);
+   return 1;
+  }
+  return batch_transfer(files[0], targets, copy_sections, jobs) == 0 ? 0 : 1;
+ }
+
+ if (file_count != 2) {
+  usage(argv[0]);
+  return 1;
+ }
+ return copy_pe_header_with_resources(files[0], files[1], copy_sections) == 0 ? 0 : 1;
 }
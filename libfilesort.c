@@ -0,0 +1,413 @@
+// By Thibaut LOMBARD (LombardWeb)
+// libfilesort : recursive scan of a directory on a thread pool, size filter, sort and top-K selection.
+// See libfilesort.h for the API, file_sort.c for the command line front end.
+#define _GNU_SOURCE
+#include "libfilesort.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define FS_PATH_LEN 4096
+#define PROGRESS_STEP 256
+
+struct fs_scan {
+ fs_file *files;
+ size_t count;
+ long errors;
+
+ // Walk state, only used while fs_scan_open() runs
+ fs_options opt;
+ const char *dir_path;
+ int root_fd;
+ char *root_abs;
+ size_t root_abs_len;
+ int (*compare)(const void *, const void *);
+ bool counting;
+ long total;
+ long processed;
+ int failed;
+ char **dirs;
+ size_t dir_count, dir_cap;
+ int active;
+ pthread_mutex_t lock;
+ pthread_cond_t cond;
+ pthread_mutex_t callback_lock;
+};
+
+// Matches of one scan thread, merged once the walk is over
+typedef struct {
+ fs_scan *scan;
+ fs_file *items;
+ size_t count, cap;
+} fs_worker;
+
+// Comparison functions for sorting, ties broken by relative path so that the result does not
+// depend on which thread found the file first
+static int compare_path(const fs_file *a, const fs_file *b) {
+ return strcmp(a->rel_path, b->rel_path);
+}
+
+static int compare_size_asc(const void *a, const void *b) {
+ const fs_file *x = a, *y = b;
+ int c = (x->size > y->size) - (x->size < y->size);
+ return c ? c : compare_path(x, y);
+}
+
+static int compare_size_desc(const void *a, const void *b) {
+ const fs_file *x = a, *y = b;
+ int c = (y->size > x->size) - (y->size < x->size);
+ return c ? c : compare_path(x, y);
+}
+
+static int compare_date_asc(const void *a, const void *b) {
+ const fs_file *x = a, *y = b;
+ int c = (x->mtime > y->mtime) - (x->mtime < y->mtime);
+ return c ? c : compare_path(x, y);
+}
+
+static int compare_date_desc(const void *a, const void *b) {
+ const fs_file *x = a, *y = b;
+ int c = (y->mtime > x->mtime) - (y->mtime < x->mtime);
+ return c ? c : compare_path(x, y);
+}
+
+static int compare_filename_asc(const void *a, const void *b) {
+ const fs_file *x = a, *y = b;
+ int c = strcmp(x->filename, y->filename);
+ return c ? c : compare_path(x, y);
+}
+
+static int compare_filename_desc(const void *a, const void *b) {
+ const fs_file *x = a, *y = b;
+ int c = strcmp(y->filename, x->filename);
+ return c ? c : compare_path(x, y);
+}
+
+fs_options fs_default_options(void) {
+ fs_options opt;
+ memset(&opt, 0, sizeof(opt));
+ opt.sort_by = FS_SORT_SIZE;
+ opt.order = FS_ORDER_DESC;
+ return opt;
+}
+
+static void report_error(fs_scan *s, fs_error_kind kind, const char *rel, int err) {
+ pthread_mutex_lock(&s->callback_lock);
+ s->errors++;
+ if (s->opt.on_error) {
+  char path[FS_PATH_LEN];
+  snprintf(path, FS_PATH_LEN, "%s%s%s", s->dir_path, *rel ? "/" : "", rel);
+  s->opt.on_error(kind, path, err, s->opt.user);
+ }
+ pthread_mutex_unlock(&s->callback_lock);
+}
+
+static void report_progress(fs_scan *s, long processed) {
+ pthread_mutex_lock(&s->callback_lock);
+ s->opt.progress(processed, s->total, s->opt.user);
+ pthread_mutex_unlock(&s->callback_lock);
+}
+
+// Max-heap on the sort order : the root is the kept file that sorts last, the first one to evict
+static void heap_sift_up(fs_file *heap, size_t i, int (*compare)(const void *, const void *)) {
+ while (i > 0) {
+  size_t parent = (i - 1) / 2;
+  if (compare(&heap[i], &heap[parent]) <= 0) break;
+  fs_file tmp = heap[i];
+  heap[i] = heap[parent];
+  heap[parent] = tmp;
+  i = parent;
+ }
+}
+
+static void heap_sift_down(fs_file *heap, size_t n, size_t i, int (*compare)(const void *, const void *)) {
+ for (;;) {
+  size_t left = 2 * i + 1, right = left + 1, largest = i;
+  if (left < n && compare(&heap[left], &heap[largest]) > 0) largest = left;
+  if (right < n && compare(&heap[right], &heap[largest]) > 0) largest = right;
+  if (largest == i) break;
+  fs_file tmp = heap[i];
+  heap[i] = heap[largest];
+  heap[largest] = tmp;
+  i = largest;
+ }
+}
+
+// Keep a matching file : appended, or with top_k only if it beats the worst file kept by this thread
+static void add_file(fs_worker *w, const char *rel, const char *name, const struct stat *st) {
+ fs_scan *s = w->scan;
+ fs_file f;
+ f.rel_path = rel;
+ f.filename = name;
+ f.size = st->st_size;
+ f.mtime = st->st_mtime;
+ bool evict = s->opt.top_k && w->count >= s->opt.top_k;
+ if (evict && s->compare(&f, &w->items[0]) >= 0) return;
+
+ // One allocation per file : abs_path, rel_path and filename all point into it
+ size_t rel_len = strlen(rel);
+ char *abs = malloc(s->root_abs_len + 1 + rel_len + 1);
+ if (!abs) {
+  s->failed = ENOMEM;
+  return;
+ }
+ memcpy(abs, s->root_abs, s->root_abs_len);
+ size_t prefix = s->root_abs_len;
+ if (prefix == 0 || abs[prefix - 1] != '/') abs[prefix++] = '/';
+ memcpy(abs + prefix, rel, rel_len + 1);
+ f.abs_path = abs;
+ f.rel_path = abs + prefix;
+ f.filename = f.rel_path + (name - rel);
+ const char *dot = strrchr(f.filename, '.');
+ f.extension = dot && dot != f.filename ? dot + 1 : "no_extension";
+ f.size_mb = st->st_size / 1048576.0;
+ struct tm tm;
+ localtime_r(&st->st_mtime, &tm);
+ strftime(f.date, FS_DATE_LEN, "%Y-%m-%d %H:%M:%S %z", &tm);
+
+ if (evict) {
+  free((char *)w->items[0].abs_path);
+  w->items[0] = f;
+  heap_sift_down(w->items, w->count, 0, s->compare);
+  return;
+ }
+ if (w->count == w->cap) {
+  size_t cap = w->cap ? w->cap * 2 : 256;
+  if (s->opt.top_k && cap > s->opt.top_k) cap = s->opt.top_k;
+  fs_file *items = realloc(w->items, cap * sizeof(fs_file));
+  if (!items) {
+   free(abs);
+   s->failed = ENOMEM;
+   return;
+  }
+  w->items = items;
+  w->cap = cap;
+ }
+ w->items[w->count++] = f;
+ if (s->opt.top_k) heap_sift_up(w->items, w->count - 1, s->compare);
+}
+
+static void push_directory(fs_scan *s, const char *rel) {
+ char *copy = strdup(rel);
+ pthread_mutex_lock(&s->lock);
+ if (copy && s->dir_count == s->dir_cap) {
+  size_t cap = s->dir_cap ? s->dir_cap * 2 : 64;
+  char **dirs = realloc(s->dirs, cap * sizeof(char *));
+  if (dirs) {
+   s->dirs = dirs;
+   s->dir_cap = cap;
+  } else {
+   free(copy);
+   copy = NULL;
+  }
+ }
+ if (copy) {
+  s->dirs[s->dir_count++] = copy;
+  pthread_cond_signal(&s->cond);
+ } else {
+  s->failed = ENOMEM;
+ }
+ pthread_mutex_unlock(&s->lock);
+}
+
+// List one directory (rel_dir relative to the scanned one, "" for the root) : subdirectories go back
+// to the shared stack, regular files are counted or filtered. d_type spares a stat() per directory.
+static void walk_directory(fs_worker *w, const char *rel_dir) {
+ fs_scan *s = w->scan;
+ int fd = openat(s->root_fd, *rel_dir ? rel_dir : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+ DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+ if (!dir) {
+  int err = errno;
+  if (fd >= 0) close(fd);
+  if (!s->counting) report_error(s, FS_ERR_OPENDIR, rel_dir, err);
+  return;
+ }
+
+ struct dirent *entry;
+ char rel_path[FS_PATH_LEN];
+ while ((entry = readdir(dir)) != NULL) {
+  if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+  int len = snprintf(rel_path, FS_PATH_LEN, "%s%s%s", rel_dir, *rel_dir ? "/" : "", entry->d_name);
+  if (len >= FS_PATH_LEN) {
+   if (!s->counting) report_error(s, FS_ERR_STAT, rel_path, ENAMETOOLONG);
+   continue;
+  }
+
+  unsigned char type = entry->d_type;
+  struct stat st;
+  bool have_stat = false;
+  if (type == DT_UNKNOWN || type == DT_LNK || (type == DT_REG && !s->counting)) {
+   // Symlinks are followed, like stat() in the original walk
+   if (fstatat(dirfd(dir), entry->d_name, &st, 0) == -1) {
+    if (!s->counting) report_error(s, FS_ERR_STAT, rel_path, errno);
+    continue;
+   }
+   have_stat = true;
+   type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+  }
+
+  if (type == DT_DIR) {
+   push_directory(s, rel_path);
+  } else if (type == DT_REG) {
+   if (s->counting) {
+    __atomic_add_fetch(&s->total, 1, __ATOMIC_RELAXED);
+    continue;
+   }
+   if (!have_stat) continue;
+   if (st.st_size / 1048576.0 > s->opt.min_size_mb) {
+    add_file(w, rel_path, rel_path + len - strlen(entry->d_name), &st);
+   }
+   long processed = __atomic_add_fetch(&s->processed, 1, __ATOMIC_RELAXED);
+   if (s->opt.progress && processed % PROGRESS_STEP == 0) report_progress(s, processed);
+  }
+ }
+ closedir(dir);
+}
+
+static void *walk_worker(void *arg) {
+ fs_worker *w = arg;
+ fs_scan *s = w->scan;
+ for (;;) {
+  pthread_mutex_lock(&s->lock);
+  while (s->dir_count == 0 && s->active > 0) pthread_cond_wait(&s->cond, &s->lock);
+  if (s->dir_count == 0) {
+   pthread_mutex_unlock(&s->lock);
+   break;
+  }
+  char *rel_dir = s->dirs[--s->dir_count];
+  s->active++;
+  pthread_mutex_unlock(&s->lock);
+
+  walk_directory(w, rel_dir);
+  free(rel_dir);
+
+  pthread_mutex_lock(&s->lock);
+  if (--s->active == 0 && s->dir_count == 0) pthread_cond_broadcast(&s->cond);
+  pthread_mutex_unlock(&s->lock);
+ }
+ return NULL;
+}
+
+// Walk the whole tree once with the given workers, falls back to the calling thread alone
+static void run_walk(fs_scan *s, fs_worker *workers, int threads) {
+ push_directory(s, "");
+ pthread_t *tids = calloc(threads, sizeof(pthread_t));
+ int started = 0;
+ while (tids && started < threads && pthread_create(&tids[started], NULL, walk_worker, &workers[started]) == 0) started++;
+ if (started == 0) walk_worker(&workers[0]);
+ for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+ free(tids);
+}
+
+fs_scan *fs_scan_open(const char *dir_path, const fs_options *options) {
+ fs_options opt = options ? *options : fs_default_options();
+ if (!dir_path || opt.min_size_mb < 0 || opt.sort_by > FS_SORT_FILENAME || opt.order > FS_ORDER_ASC) {
+  errno = EINVAL;
+  return NULL;
+ }
+ if (opt.threads <= 0) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  opt.threads = cpus > 0 ? (int)cpus : 1;
+ }
+
+ fs_scan *s = calloc(1, sizeof(fs_scan));
+ fs_worker *workers = calloc(opt.threads, sizeof(fs_worker));
+ if (!s || !workers) {
+  free(s);
+  free(workers);
+  errno = ENOMEM;
+  return NULL;
+ }
+ s->opt = opt;
+ s->dir_path = dir_path;
+ pthread_mutex_init(&s->lock, NULL);
+ pthread_cond_init(&s->cond, NULL);
+ pthread_mutex_init(&s->callback_lock, NULL);
+ static int (*const compares[3][2])(const void *, const void *) = {
+  [FS_SORT_SIZE] = { compare_size_desc, compare_size_asc },
+  [FS_SORT_DATE] = { compare_date_desc, compare_date_asc },
+  [FS_SORT_FILENAME] = { compare_filename_desc, compare_filename_asc },
+ };
+ s->compare = compares[opt.sort_by][opt.order];
+
+ // Absolute paths are built from the canonical root instead of a realpath() per file
+ s->root_fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+ s->root_abs = s->root_fd >= 0 ? realpath(dir_path, NULL) : NULL;
+ if (!s->root_abs) {
+  report_error(s, FS_ERR_OPENDIR, "", errno);
+ } else {
+  s->root_abs_len = strlen(s->root_abs);
+  for (int i = 0; i < opt.threads; i++) workers[i].scan = s;
+  if (opt.progress) {
+   s->counting = true;
+   run_walk(s, workers, opt.threads);
+   s->counting = false;
+  }
+  run_walk(s, workers, opt.threads);
+  if (opt.progress) opt.progress(s->processed, s->total, opt.user);
+ }
+
+ // Merge what each thread kept, sort, and cut to top_k
+ size_t total = 0;
+ for (int i = 0; i < opt.threads; i++) total += workers[i].count;
+ s->files = total ? malloc(total * sizeof(fs_file)) : NULL;
+ if (total && !s->files) s->failed = ENOMEM;
+ for (int i = 0; i < opt.threads; i++) {
+  if (s->files) {
+   memcpy(s->files + s->count, workers[i].items, workers[i].count * sizeof(fs_file));
+   s->count += workers[i].count;
+  } else {
+   for (size_t j = 0; j < workers[i].count; j++) free((char *)workers[i].items[j].abs_path);
+  }
+  free(workers[i].items);
+ }
+ free(workers);
+ if (s->count > 1) qsort(s->files, s->count, sizeof(fs_file), s->compare);
+ if (opt.top_k && s->count > opt.top_k) {
+  for (size_t i = opt.top_k; i < s->count; i++) free((char *)s->files[i].abs_path);
+  s->count = opt.top_k;
+ }
+
+ if (s->root_fd >= 0) close(s->root_fd);
+ free(s->root_abs);
+ s->root_abs = NULL;
+ free(s->dirs);
+ s->dirs = NULL;
+ pthread_mutex_destroy(&s->lock);
+ pthread_cond_destroy(&s->cond);
+ pthread_mutex_destroy(&s->callback_lock);
+ if (s->failed) {
+  int err = s->failed;
+  fs_scan_close(s);
+  errno = err;
+  return NULL;
+ }
+ return s;
+}
+
+size_t fs_scan_count(const fs_scan *scan) {
+ return scan ? scan->count : 0;
+}
+
+const fs_file *fs_scan_get(const fs_scan *scan, size_t index) {
+ return scan && index < scan->count ? &scan->files[index] : NULL;
+}
+
+long fs_scan_errors(const fs_scan *scan) {
+ return scan ? scan->errors : 0;
+}
+
+void fs_scan_close(fs_scan *scan) {
+ if (!scan) return;
+ for (size_t i = 0; i < scan->count; i++) free((char *)scan->files[i].abs_path);
+ free(scan->files);
+ free(scan);
+}
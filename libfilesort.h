@@ -0,0 +1,69 @@
+// By Thibaut LOMBARD (LombardWeb)
+// libfilesort : scanning and sorting core of file_sort, to embed in other programs instead of running
+// file_sort and parsing its output.
+//
+//  fs_options opt = fs_default_options();
+//  opt.min_size_mb = 10;
+//  opt.top_k = 20;
+//  fs_scan *scan = fs_scan_open("download", &opt);
+//  for (size_t i = 0; scan && i < fs_scan_count(scan); i++) {
+//   const fs_file *f = fs_scan_get(scan, i);
+//   printf("%s %.2f\n", f->abs_path, f->size_mb);
+//  }
+//  fs_scan_close(scan);
+//
+// Compile : gcc -O2 -pthread -c libfilesort.c
+#ifndef LIBFILESORT_H
+#define LIBFILESORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define FS_DATE_LEN 64
+
+typedef enum { FS_SORT_SIZE, FS_SORT_DATE, FS_SORT_FILENAME } fs_sort_key;
+typedef enum { FS_ORDER_DESC, FS_ORDER_ASC } fs_sort_order;
+typedef enum { FS_ERR_OPENDIR, FS_ERR_STAT } fs_error_kind;
+
+// Callbacks run on the scan threads, one at a time
+typedef void (*fs_progress_fn)(long processed, long total, void *user);
+typedef void (*fs_error_fn)(fs_error_kind kind, const char *path, int err, void *user);
+
+typedef struct {
+ double min_size_mb;          // keep files strictly larger than this
+ fs_sort_key sort_by;
+ fs_sort_order order;
+ size_t top_k;                // keep only the first top_k files of the sort, 0 keeps everything
+ int threads;                 // scan threads, 0 for one per online CPU
+ fs_progress_fn progress;     // optional, adds a counting pass to know the total
+ fs_error_fn on_error;        // optional
+ void *user;                  // passed back to both callbacks
+} fs_options;
+
+// One matching file, owned by the scan and valid until fs_scan_close()
+typedef struct {
+ const char *abs_path;        // canonical directory + relative path
+ const char *rel_path;        // relative to the scanned directory, points into abs_path
+ const char *filename;        // points into rel_path
+ const char *extension;       // without the dot, "no_extension" when there is none
+ char date[FS_DATE_LEN];      // mtime as "%Y-%m-%d %H:%M:%S %z", local time
+ time_t mtime;
+ off_t size;
+ double size_mb;
+} fs_file;
+
+typedef struct fs_scan fs_scan;
+
+fs_options fs_default_options(void);
+
+// Scan dir_path recursively and sort the matches. Returns NULL with errno set when the options are
+// invalid or memory runs out; unreadable entries are reported through on_error and counted instead.
+fs_scan *fs_scan_open(const char *dir_path, const fs_options *options);
+size_t fs_scan_count(const fs_scan *scan);
+const fs_file *fs_scan_get(const fs_scan *scan, size_t index);
+long fs_scan_errors(const fs_scan *scan);
+void fs_scan_close(fs_scan *scan);
+
+#endif
@@ -1,5 +1,6 @@
 // by Thibaut LOMBARD (LombardWeb)
 // this executable script (once compiled) permit to set metadata of modification date, and create date to the date of today
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,13 +9,88 @@
 #include <time.h>
 #include <unistd.h>
 #include <stdarg.h>  // Added for va_list
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define MAX_PATH 4096
 #define MAX_CMD 8192
+#define QT_EPOCH_OFFSET 2082844800ULL  // seconds between 1904-01-01 (QuickTime epoch) and 1970-01-01
+#define EXIF_DATE_LEN 19  // "YYYY:MM:DD HH:MM:SS" without the NUL
+#define QUEUE_SIZE 1024
+#define SNIFF_SIZE 512  // bytes read once per file to detect its format
+#define XMP_MAX_EDITS 64
+#define XMP_NONE -1     // no XMP packet in the file
+#define XMP_NO_ROOM -2  // a packet has not enough padding for the new dates, or cannot be rewritten safely
+#define NATIVE_EXIF 1       // date groups already refreshed natively, skipped by the heuristic pass
+#define NATIVE_QUICKTIME 2
+#define NATIVE_XMP 4
+
+// File formats recognized from their magic numbers
+typedef enum {
+ FMT_UNKNOWN,
+ FMT_JPEG,
+ FMT_TIFF,
+ FMT_PNG,
+ FMT_GIF,
+ FMT_WEBP,
+ FMT_PSD,
+ FMT_PDF,
+ FMT_QUICKTIME,
+ FMT_HEIC,
+ FMT_RAW,   // camera raw files that are not plain TIFF (ORF, RW2, RAF, CRW, MRW, X3F)
+ FMT_AVI
+} FileFormat;
+
+// Identity of a refreshed file as stored in the journal
+typedef struct {
+ uint64_t dev, ino, size;
+ int64_t mtime;
+} JournalKey;
+
+const char *format_names[] = {"unknown", "JPEG", "TIFF", "PNG", "GIF", "WebP", "PSD", "PDF", "MP4/MOV", "HEIC/AVIF", "camera raw", "AVI"};
 
 // Global flags
 int verbose = 0;
 int heuristic = 0;
+int jobs = 0;
+int have_exiftool = 0;
+
+// Date used for every file, captured once at startup
+time_t run_time;
+char run_date[20];
+char run_xmp_date[32];  // same date in XMP form: 2025-03-08T18:43:13+01:00
+
+// Completion journal: "R <time>" starts a run, "F <dev> <ino> <size> <mtime>" marks a
+// refreshed file, "D <time>" closes the run. Files of an unfinished run are skipped on restart.
+// A completed run compacts the file down to its R/D pair, all --since needs.
+struct {
+ const char *path;
+ int fd;
+ JournalKey *keys;  // open addressing table, ino == 0 marks an empty slot
+ size_t cap, count;
+ dev_t self_dev;
+ ino_t self_ino;
+ time_t last_run;  // start of the last completed run, 0 if none
+} journal = {.fd = -1};
+int since = 0;
+
+// Bounded queue feeding the worker pool
+struct {
+ char *paths[QUEUE_SIZE];
+ int head, tail, count, done;
+ pthread_mutex_t lock;
+ pthread_cond_t not_empty, not_full;
+} queue = {
+ .lock = PTHREAD_MUTEX_INITIALIZER,
+ .not_empty = PTHREAD_COND_INITIALIZER,
+ .not_full = PTHREAD_COND_INITIALIZER
+};
 
 // Arrays of tags
 const char *metadata_tags[] = {
@@ -27,19 +103,17 @@ const char *metadata_tags[] = {
  NULL
 };
 
-const char *filesystem_tags[] = {
- "FileModifyDate",
- "FileAccessDate",
- "FileInodeChangeDate",
- NULL
-};
+// Verbose output of the file being processed by this thread, flushed in one piece so that
+// the lines of concurrent workers do not interleave
+static __thread FILE *verbose_buffer;
+pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
 
 // Verbose output function (renamed from vprintf to verbose_print)
 void verbose_print(const char *format, ...) {
  if (verbose) {
   va_list args;
   va_start(args, format);
-  vfprintf(stdout, format, args);  // Using vfprintf instead of vprintf
+  vfprintf(verbose_buffer ? verbose_buffer : stdout, format, args);  // Using vfprintf instead of vprintf
   va_end(args);
  }
 }
@@ -51,9 +125,7 @@ int check_exiftool() {
 
 // Execute command and return status
 int execute_command(const char *cmd) {
- if (verbose) {
-  printf("Executing: %s\n", cmd);
- }
+ verbose_print("Executing: %s\n", cmd);
  return system(cmd);
 }
 
@@ -64,96 +136,901 @@ int tag_exists(const char *file, const char *tag) {
  return system(cmd) == 0;
 }
 
-// Process a single file
-void process_file(const char *file) {
+// Big endian helpers for ISO-BMFF boxes
+static uint32_t rd_be32(const unsigned char *p) {
+ return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t rd_be64(const unsigned char *p) {
+ return ((uint64_t)rd_be32(p) << 32) | rd_be32(p + 4);
+}
+
+static void wr_be32(unsigned char *p, uint32_t v) {
+ p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static void wr_be64(unsigned char *p, uint64_t v) {
+ wr_be32(p, v >> 32);
+ wr_be32(p + 4, (uint32_t)v);
+}
+
+// Overwrite creation/modification time of a mvhd, tkhd or mdhd full box
+// payload points right after the box header, file_off is its position in the file
+static int mp4_patch_times(int fd, const unsigned char *payload, uint64_t len, off_t file_off, uint64_t qt_time) {
+ unsigned char buf[16];
+ size_t n;
+
+ if (len < 4) return -1;
+ if (payload[0] == 1) {
+  // version 1: 64-bit creation_time + modification_time
+  if (len < 4 + 16) return -1;
+  wr_be64(buf, qt_time);
+  wr_be64(buf + 8, qt_time);
+  n = 16;
+ } else {
+  // version 0: 32-bit fields, good until 2040
+  if (len < 4 + 8 || qt_time > UINT32_MAX) return -1;
+  wr_be32(buf, (uint32_t)qt_time);
+  wr_be32(buf + 4, (uint32_t)qt_time);
+  n = 8;
+ }
+ return pwrite(fd, buf, n, file_off + 4) == (ssize_t)n ? 0 : -1;
+}
+
+// Walk boxes in [start, end) of the mapped moov atom, recursing into trak/mdia
+// map_off is the file offset of base[0], boxes that could not be patched are counted in *skipped
+static int mp4_walk(int fd, const unsigned char *base, uint64_t start, uint64_t end, off_t map_off, uint64_t qt_time,
+        const char *file, int *skipped) {
+ int patched = 0;
+ uint64_t pos = start;
+
+ while (end - pos >= 8) {
+  uint64_t size = rd_be32(base + pos);
+  uint64_t hdr = 8;
+  const char *type = (const char *)base + pos + 4;
+
+  if (size == 1) {
+   if (end - pos < 16) break;
+   size = rd_be64(base + pos + 8);
+   hdr = 16;
+  } else if (size == 0) {
+   size = end - pos;  // box extends to the end of its parent
+  }
+  if (size < hdr || size > end - pos) break;
+
+  if (memcmp(type, "trak", 4) == 0 || memcmp(type, "mdia", 4) == 0) {
+   patched += mp4_walk(fd, base, pos + hdr, pos + size, map_off, qt_time, file, skipped);
+  } else if (memcmp(type, "mvhd", 4) == 0 || memcmp(type, "tkhd", 4) == 0 || memcmp(type, "mdhd", 4) == 0) {
+   const char *tags = type[1] == 'v' ? "CreateDate/ModifyDate" :
+        type[1] == 'k' ? "TrackCreateDate/TrackModifyDate" : "MediaCreateDate/MediaModifyDate";
+   if (mp4_patch_times(fd, base + pos + hdr, size - hdr, map_off + (off_t)(pos + hdr), qt_time) == 0) {
+    verbose_print("Updated %s (%.4s) natively for %s\n", tags, type, file);
+    patched++;
+   } else {
+    verbose_print("Failed to update %s (%.4s) for %s\n", tags, type, file);
+    (*skipped)++;
+   }
+  }
+  pos += size;
+ }
+ return patched;
+}
+
+// Patch QuickTime dates of an MP4/MOV file in place, media data is never touched
+// Returns the number of boxes patched, or -1 if the file is not a usable ISO-BMFF file
+// Boxes left stale (version 0 past 2040, truncated, write errors) are counted in *skipped
+int mp4_refresh_dates(int fd, uint64_t file_size, const char *file, time_t now, int *skipped) {
+ // Locate the top level moov atom reading only box headers
+ uint64_t pos = 0, moov_off = 0, moov_size = 0;
+ int first = 1;
+ while (file_size - pos >= 8) {
+  unsigned char hdr[16];
+  if (pread(fd, hdr, sizeof(hdr), pos) < 8) break;
+  uint64_t size = rd_be32(hdr);
+  if (size == 1) {
+   if (file_size - pos < 16) break;
+   size = rd_be64(hdr + 8);
+  } else if (size == 0) {
+   size = file_size - pos;
+  }
+  if (first) {
+   // Reject anything that does not start like a QuickTime/MP4 file
+   if (memcmp(hdr + 4, "ftyp", 4) && memcmp(hdr + 4, "moov", 4) && memcmp(hdr + 4, "mdat", 4) &&
+     memcmp(hdr + 4, "wide", 4) && memcmp(hdr + 4, "free", 4) && memcmp(hdr + 4, "skip", 4)) {
+    break;
+   }
+   first = 0;
+  }
+  if (size < 8 || size > file_size - pos) break;
+  if (memcmp(hdr + 4, "moov", 4) == 0) {
+   moov_off = pos;
+   moov_size = size;
+   break;
+  }
+  pos += size;
+ }
+ if (!moov_size) return -1;
+
+ // Map only the moov atom, mmap offsets must be page aligned
+ long page = sysconf(_SC_PAGESIZE);
+ off_t map_off = moov_off & ~((uint64_t)page - 1);
+ size_t map_len = moov_size + (moov_off - map_off);
+ unsigned char *map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, fd, map_off);
+ if (map == MAP_FAILED) return -1;
+
+ uint64_t start = moov_off - map_off;
+ uint64_t hdr = rd_be32(map + start) == 1 ? 16 : 8;
+ int patched = mp4_walk(fd, map, start + hdr, start + moov_size, map_off, (uint64_t)now + QT_EPOCH_OFFSET, file, skipped);
+
+ munmap(map, map_len);
+ return patched;
+}
+
+// Byte order aware helpers for TIFF structures
+static uint16_t tiff_rd16(const unsigned char *p, int le) {
+ return le ? (uint16_t)(p[0] | (p[1] << 8)) : (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t tiff_rd32(const unsigned char *p, int le) {
+ return le ? ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24)) : rd_be32(p);
+}
+
+// Overwrite the ASCII date entries of one IFD, reports the ExifIFD pointer if present
+// and counts the date entries left to exiftool in *skipped
+static int exif_patch_ifd(int fd, const unsigned char *tiff, size_t tiff_len, off_t tiff_off, uint32_t ifd, int le,
+        const char *date_str, const char *file, uint32_t *exif_ifd, int *skipped) {
+ int patched = 0;
+
+ if (ifd < 8 || tiff_len < 2 || ifd > tiff_len - 2) return 0;
+ uint16_t count = tiff_rd16(tiff + ifd, le);
+ if ((size_t)count * 12 > tiff_len - ifd - 2) return 0;
+
+ for (uint16_t i = 0; i < count; i++) {
+  const unsigned char *e = tiff + ifd + 2 + (size_t)i * 12;
+  uint16_t tag = tiff_rd16(e, le);
+  const char *name = NULL;
+
+  if (tag == 0x8769 && exif_ifd) {
+   *exif_ifd = tiff_rd32(e + 8, le);
+   continue;
+  }
+  if (tag == 0x0132) name = "ModifyDate";
+  else if (tag == 0x9003) name = "DateTimeOriginal";
+  else if (tag == 0x9004) name = "CreateDate";
+  else continue;
+
+  // Only fixed width ASCII values are rewritten, anything else is left to exiftool
+  uint32_t n = tiff_rd32(e + 4, le);
+  uint32_t off = tiff_rd32(e + 8, le);
+  if (tiff_rd16(e + 2, le) != 2 || n < EXIF_DATE_LEN + 1 || tiff_len < EXIF_DATE_LEN + 1 || off > tiff_len - (EXIF_DATE_LEN + 1)) {
+   verbose_print("Skipping %s - unexpected EXIF layout in %s\n", name, file);
+   (*skipped)++;
+   continue;
+  }
+  if (pwrite(fd, date_str, EXIF_DATE_LEN, tiff_off + off) == EXIF_DATE_LEN) {
+   verbose_print("Updated %s natively for %s\n", name, file);
+   patched++;
+  } else {
+   verbose_print("Failed to update %s for %s\n", name, file);
+   (*skipped)++;
+  }
+ }
+ return patched;
+}
+
+// Patch IFD0 and ExifIFD dates of a TIFF block, tiff_off is its position in the file
+static int exif_patch_tiff(int fd, const unsigned char *tiff, size_t tiff_len, off_t tiff_off, const char *date_str,
+        const char *file, int *skipped) {
+ if (tiff_len < 8) return -1;
+
+ int le;
+ if (memcmp(tiff, "II*\0", 4) == 0) le = 1;
+ else if (memcmp(tiff, "MM\0*", 4) == 0) le = 0;
+ else return -1;
+
+ uint32_t exif_ifd = 0;
+ int patched = exif_patch_ifd(fd, tiff, tiff_len, tiff_off, tiff_rd32(tiff + 4, le), le, date_str, file, &exif_ifd, skipped);
+ if (exif_ifd) patched += exif_patch_ifd(fd, tiff, tiff_len, tiff_off, exif_ifd, le, date_str, file, NULL, skipped);
+ return patched;
+}
+
+// Patch EXIF dates of a JPEG or TIFF file in place, only the 19 date bytes are written
+// Returns the number of tags patched, or -1 if the file has no EXIF block we can parse
+// Date entries that could not be rewritten are counted in *skipped
+int exif_refresh_dates(int fd, uint64_t file_size, const char *file, const char *date_str, int *skipped) {
+ if (file_size < 8) return -1;
+
+ size_t len = file_size;
+ unsigned char *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+ if (map == MAP_FAILED) return -1;
+
+ int patched = -1;
+ if (map[0] == 0xFF && map[1] == 0xD8) {
+  // JPEG: walk the markers up to the start of scan looking for the APP1 Exif segment
+  size_t pos = 2;
+  while (pos + 4 <= len && map[pos] == 0xFF) {
+   unsigned char marker = map[pos + 1];
+   if (marker == 0xFF) {  // fill byte
+    pos++;
+    continue;
+   }
+   if (marker == 0xDA || marker == 0xD9) break;
+   size_t seg_len = ((size_t)map[pos + 2] << 8) | map[pos + 3];
+   if (seg_len < 2 || pos + 2 + seg_len > len) break;
+   if (marker == 0xE1 && seg_len >= 8 + 8 && memcmp(map + pos + 4, "Exif\0\0", 6) == 0) {
+    patched = exif_patch_tiff(fd, map + pos + 10, seg_len - 8, pos + 10, date_str, file, skipped);
+    break;
+   }
+   pos += 2 + seg_len;
+  }
+ } else {
+  patched = exif_patch_tiff(fd, map, len, 0, date_str, file, skipped);
+ }
+
+ munmap(map, len);
+ return patched;
+}
+
+static uint64_t journal_hash(const JournalKey *k) {
+ uint64_t h = k->ino * 0x9E3779B97F4A7C15ULL;
+ h ^= (k->dev + (h << 6) + (h >> 2));
+ h ^= (k->size + (h << 6) + (h >> 2));
+ h ^= ((uint64_t)k->mtime + (h << 6) + (h >> 2));
+ return h ^ (h >> 31);
+}
+
+static int journal_insert(const JournalKey *k) {
+ if ((journal.count + 1) * 2 > journal.cap) {
+  // Grow and rehash, the table stays at most half full
+  size_t cap = journal.cap ? journal.cap * 2 : 1024;
+  JournalKey *keys = calloc(cap, sizeof(JournalKey));
+  if (!keys) return -1;
+  for (size_t i = 0; i < journal.cap; i++) {
+   if (!journal.keys[i].ino) continue;
+   size_t j = journal_hash(&journal.keys[i]) & (cap - 1);
+   while (keys[j].ino) j = (j + 1) & (cap - 1);
+   keys[j] = journal.keys[i];
+  }
+  free(journal.keys);
+  journal.keys = keys;
+  journal.cap = cap;
+ }
+ size_t j = journal_hash(k) & (journal.cap - 1);
+ while (journal.keys[j].ino) {
+  if (memcmp(&journal.keys[j], k, sizeof(JournalKey)) == 0) return 0;
+  j = (j + 1) & (journal.cap - 1);
+ }
+ journal.keys[j] = *k;
+ journal.count++;
+ return 0;
+}
+
+// Read only after loading, so workers can look up without locking
+static int journal_contains(const JournalKey *k) {
+ if (!journal.cap) return 0;
+ size_t j = journal_hash(k) & (journal.cap - 1);
+ while (journal.keys[j].ino) {
+  if (memcmp(&journal.keys[j], k, sizeof(JournalKey)) == 0) return 1;
+  j = (j + 1) & (journal.cap - 1);
+ }
+ return 0;
+}
+
+static void journal_key(const struct stat *st, JournalKey *k) {
+ memset(k, 0, sizeof(*k));
+ k->dev = st->st_dev;
+ k->ino = st->st_ino;
+ k->size = st->st_size;
+ k->mtime = st->st_mtime;
+}
+
+// Load the journal, keep the files of an unfinished run and open it for appending
+int journal_open(const char *path) {
+ journal.path = path;
+ FILE *fp = fopen(path, "r");
+ if (fp) {
+  char line[256];
+  time_t run_start = 0;
+  while (fgets(line, sizeof(line), fp)) {
+   JournalKey k;
+   long long t;
+   unsigned long long dev, ino, size;
+   if (sscanf(line, "F %llu %llu %llu %lld", &dev, &ino, &size, &t) == 4) {
+    k.dev = dev;
+    k.ino = ino;
+    k.size = size;
+    k.mtime = t;
+    if (k.ino && journal_insert(&k) != 0) {
+     fprintf(stderr, "Error: Memory allocation failed while loading journal %s\n", path);
+     fclose(fp);
+     return -1;
+    }
+   } else if (sscanf(line, "R %lld", &t) == 1) {
+    run_start = t;
+   } else if (sscanf(line, "D %lld", &t) == 1) {
+    // Run completed: its files are done, the next run starts from scratch
+    journal.last_run = run_start;
+    journal.count = 0;
+    if (journal.keys) memset(journal.keys, 0, journal.cap * sizeof(JournalKey));
+   }
+  }
+  fclose(fp);
+ }
+
+ journal.fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+ if (journal.fd < 0) {
+  fprintf(stderr, "Error: Cannot open journal %s: %s\n", path, strerror(errno));
+  return -1;
+ }
  struct stat st;
- if (stat(file, &st) != 0 || !S_ISREG(st.st_mode)) {
-  return;  // Skip if not a regular file
+ if (fstat(journal.fd, &st) == 0) {
+  journal.self_dev = st.st_dev;
+  journal.self_ino = st.st_ino;
+ }
+ if (journal.count) {
+  verbose_print("Resuming interrupted run, %zu files already refreshed\n", journal.count);
+ }
+
+ char rec[64];
+ int len = snprintf(rec, sizeof(rec), "R %lld\n", (long long)run_time);
+ if (write(journal.fd, rec, len) != len) return -1;
+ return 0;
+}
+
+// One write per record, O_APPEND keeps concurrent workers from interleaving
+void journal_record(const struct stat *st) {
+ char rec[128];
+ int len = snprintf(rec, sizeof(rec), "F %llu %llu %llu %lld\n", (unsigned long long)st->st_dev,
+    (unsigned long long)st->st_ino, (unsigned long long)st->st_size, (long long)st->st_mtime);
+ if (write(journal.fd, rec, len) != len) {
+  verbose_print("Failed to write journal record: %s\n", strerror(errno));
+ }
+}
+
+void journal_close(void) {
+ char rec[64];
+ int len = snprintf(rec, sizeof(rec), "D %lld\n", (long long)run_time);
+ if (write(journal.fd, rec, len) != len || fsync(journal.fd) != 0) {
+  fprintf(stderr, "Error: Cannot complete journal: %s\n", strerror(errno));
+  close(journal.fd);
+  free(journal.keys);
+  return;
+ }
+ close(journal.fd);
+ free(journal.keys);
+
+ // The F records of a completed run are never read again: replace the journal by this run's
+ // R/D pair, through a rename so that a crash leaves either the old or the compacted file
+ char tmp[MAX_PATH];
+ len = snprintf(rec, sizeof(rec), "R %lld\nD %lld\n", (long long)run_time, (long long)run_time);
+ if (snprintf(tmp, MAX_PATH, "%s.tmp", journal.path) >= MAX_PATH) return;
+ int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+ if (fd < 0) return;
+ int ok = write(fd, rec, len) == len && fsync(fd) == 0;
+ if (close(fd) != 0 || !ok || rename(tmp, journal.path) != 0) {
+  verbose_print("Cannot compact journal %s: %s\n", journal.path, strerror(errno));
+  unlink(tmp);
  }
+}
 
- // Get current time
- time_t now = time(NULL);
- struct tm *tm = localtime(&now);
- char date_str[20];
- strftime(date_str, sizeof(date_str), "%Y:%m:%d %H:%M:%S", tm);
+// Classify a file from its first bytes
+FileFormat sniff_format(const unsigned char *h, size_t n) {
+ if (n >= 3 && h[0] == 0xFF && h[1] == 0xD8 && h[2] == 0xFF) return FMT_JPEG;
+ if (n >= 4 && (memcmp(h, "II*\0", 4) == 0 || memcmp(h, "MM\0*", 4) == 0)) return FMT_TIFF;
+ if (n >= 8 && memcmp(h, "\x89PNG\r\n\x1a\n", 8) == 0) return FMT_PNG;
+ if (n >= 4 && memcmp(h, "GIF8", 4) == 0) return FMT_GIF;
+ if (n >= 12 && memcmp(h, "RIFF", 4) == 0 && memcmp(h + 8, "WEBP", 4) == 0) return FMT_WEBP;
+ if (n >= 12 && memcmp(h, "RIFF", 4) == 0 && memcmp(h + 8, "AVI ", 4) == 0) return FMT_AVI;
+ // TIFF-like raw headers with their own magic (Olympus, Panasonic), then Fuji, Canon CRW, Minolta, Sigma
+ if (n >= 4 && (memcmp(h, "IIRO", 4) == 0 || memcmp(h, "IIRS", 4) == 0 || memcmp(h, "MMOR", 4) == 0 ||
+     memcmp(h, "IIU\0", 4) == 0)) return FMT_RAW;
+ if (n >= 15 && memcmp(h, "FUJIFILMCCD-RAW", 15) == 0) return FMT_RAW;
+ if (n >= 14 && memcmp(h, "II\x1a\0\0\0HEAPCCDR", 14) == 0) return FMT_RAW;
+ if (n >= 4 && (memcmp(h, "\0MRM", 4) == 0 || memcmp(h, "FOVb", 4) == 0)) return FMT_RAW;
+ if (n >= 4 && memcmp(h, "8BPS", 4) == 0) return FMT_PSD;
+ if (n >= 5 && memcmp(h, "%PDF-", 5) == 0) return FMT_PDF;
+ if (n >= 12 && memcmp(h + 4, "ftyp", 4) == 0) {
+  // HEIF/AVIF and Canon CR3 share the ISO-BMFF layout but keep their dates elsewhere
+  static const char *still_brands[] = {"heic", "heix", "hevc", "hevx", "heim", "heis", "mif1", "msf1", "avif", "avis", "crx ", NULL};
+  for (int i = 0; still_brands[i]; i++) {
+   if (memcmp(h + 8, still_brands[i], 4) == 0) return FMT_HEIC;
+  }
+  return FMT_QUICKTIME;
+ }
+ if (n >= 8 && (memcmp(h + 4, "moov", 4) == 0 || memcmp(h + 4, "mdat", 4) == 0 ||
+     memcmp(h + 4, "wide", 4) == 0 || memcmp(h + 4, "free", 4) == 0 || memcmp(h + 4, "skip", 4) == 0)) {
+  return FMT_QUICKTIME;
+ }
+ return FMT_UNKNOWN;
+}
 
- verbose_print("Processing: %s\n", file);
- verbose_print("Using date: %s\n", date_str);
+// Find needle in the mapped file, SSE2 tests 16 positions per step on the first and
+// last needle bytes and only calls memcmp on candidates
+static const unsigned char *find_bytes(const unsigned char *hay, size_t len, const char *needle, size_t nlen) {
+ if (nlen < 2 || len < nlen) return NULL;
+ size_t i = 0;
+#ifdef __SSE2__
+ const __m128i first = _mm_set1_epi8(needle[0]);
+ const __m128i last = _mm_set1_epi8(needle[nlen - 1]);
+ for (; i + nlen - 1 + 16 <= len; i += 16) {
+  __m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+  __m128i b = _mm_loadu_si128((const __m128i *)(hay + i + nlen - 1));
+  unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+  while (mask) {
+   int bit = __builtin_ctz(mask);
+   if (memcmp(hay + i + bit, needle, nlen) == 0) return hay + i + bit;
+   mask &= mask - 1;
+  }
+ }
+#endif
+ for (; i + nlen <= len; i++) {
+  if (hay[i] == (unsigned char)needle[0] && memcmp(hay + i, needle, nlen) == 0) return hay + i;
+ }
+ return NULL;
+}
+
+static int xmp_name_char(unsigned char c) {
+ return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == ':' || c == '_' || c == '-' || c == '.';
+}
 
+static int xmp_space(unsigned char c) {
+ return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// xmp:*Date (CreateDate, ModifyDate, MetadataDate) and photoshop:DateCreated
+static int xmp_is_date_property(const unsigned char *name, size_t len) {
+ if (len >= 8 && memcmp(name, "xmp:", 4) == 0 && memcmp(name + len - 4, "Date", 4) == 0) return 1;
+ return len == 21 && memcmp(name, "photoshop:DateCreated", 21) == 0;
+}
+
+// Collect the date values of one packet, as attributes (name="value") or elements (<name>value<)
+static int xmp_find_dates(const unsigned char *p, size_t len, size_t *val_off, size_t *val_len) {
+ int n = 0;
+ for (size_t i = 1; i < len && n < XMP_MAX_EDITS; i++) {
+  if (p[i] != 'x' && p[i] != 'p') continue;
+  if (!xmp_space(p[i - 1]) && p[i - 1] != '<') continue;
+  size_t end = i;
+  while (end < len && xmp_name_char(p[end])) end++;
+  if (!xmp_is_date_property(p + i, end - i)) continue;
+
+  size_t v = end, v_end;
+  if (p[i - 1] == '<') {
+   if (v >= len || p[v] != '>') continue;
+   v++;
+   v_end = v;
+   while (v_end < len && p[v_end] != '<') v_end++;
+  } else {
+   while (v < len && xmp_space(p[v])) v++;
+   if (v >= len || p[v] != '=') continue;
+   v++;
+   while (v < len && xmp_space(p[v])) v++;
+   if (v >= len || (p[v] != '"' && p[v] != '\'')) continue;
+   unsigned char quote = p[v++];
+   v_end = v;
+   while (v_end < len && p[v_end] != quote) v_end++;
+  }
+  // Only rewrite values that really start like a year
+  if (v_end >= len || v_end - v < 4 || p[v] < '0' || p[v] > '9' || p[v + 3] < '0' || p[v + 3] > '9') continue;
+  val_off[n] = v;
+  val_len[n] = v_end - v;
+  n++;
+  i = v_end;
+ }
+ return n;
+}
+
+// CRC-32 of PNG chunks (ISO 3309), bitwise: only the XMP chunk is ever summed
+static uint32_t crc32_update(uint32_t crc, const unsigned char *p, size_t len) {
+ while (len--) {
+  crc ^= *p++;
+  for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+ }
+ return crc;
+}
+
+// Check that [start, end) sits inside a single container segment that may be rewritten as is.
+// For PNG, *chunk receives the offset of the enclosing chunk, whose CRC must then be recomputed.
+static int xmp_container(const unsigned char *map, size_t len, FileFormat format, size_t start, size_t end, size_t *chunk) {
+ *chunk = 0;
+ if (format == FMT_JPEG) {
+  // Standard XMP APP1 only: Extended XMP is split over several segments and checked by a digest
+  static const char xap[] = "http://ns.adobe.com/xap/1.0/";
+  size_t pos = 2;
+  while (pos + 4 <= len && map[pos] == 0xFF) {
+   unsigned char marker = map[pos + 1];
+   if (marker == 0xFF) {
+    pos++;
+    continue;
+   }
+   if (marker == 0xDA || marker == 0xD9) break;
+   size_t seg_len = ((size_t)map[pos + 2] << 8) | map[pos + 3];
+   if (seg_len < 2 || pos + 2 + seg_len > len) break;
+   if (start >= pos + 4 && end <= pos + 2 + seg_len) {
+    return marker == 0xE1 && seg_len >= 2 + sizeof(xap) && memcmp(map + pos + 4, xap, sizeof(xap)) == 0 ? 0 : -1;
+   }
+   pos += 2 + seg_len;
+  }
+  return -1;
+ }
+ if (format == FMT_PNG) {
+  size_t pos = 8;
+  while (len - pos >= 12) {
+   size_t data_len = rd_be32(map + pos);
+   if (data_len > len - pos - 12) break;
+   if (start >= pos + 8 && end <= pos + 8 + data_len) {
+    *chunk = pos;
+    return 0;
+   }
+   pos += 12 + data_len;
+  }
+  return -1;
+ }
+ // GIF stores XMP as raw bytes that double as sub-block lengths, any change breaks the stream
+ if (format == FMT_GIF) return -1;
+ return 0;
+}
+
+// Rewrite the dates of every <x:xmpmeta> packet in place, growing into the packet padding
+// Returns the number of dates patched, XMP_NONE without packet, XMP_NO_ROOM if one did not fit
+// or was left to exiftool because it does not sit inside a single container segment
+int xmp_refresh_dates(int fd, uint64_t file_size, const char *file, FileFormat format) {
+ if (file_size < 16) return XMP_NONE;
+ size_t len = file_size;
+ unsigned char *map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+ if (map == MAP_FAILED) return XMP_NONE;
+ madvise(map, len, MADV_SEQUENTIAL);
+
+ int patched = 0, packets = 0, no_room = 0;
+ size_t new_len = strlen(run_xmp_date);
+ const unsigned char *meta = map;
+ while ((meta = find_bytes(meta, len - (meta - map), "<x:xmpmeta", 10))) {
+  const unsigned char *meta_end = find_bytes(meta, len - (meta - map), "</x:xmpmeta>", 12);
+  if (!meta_end) break;
+  meta_end += 12;
+  packets++;
+
+  // The padding is the whitespace between </x:xmpmeta> and the <?xpacket end trailer
+  const unsigned char *pad_end = meta_end;
+  while (pad_end < map + len && xmp_space(*pad_end)) pad_end++;
+  if (len - (pad_end - map) < 13 || memcmp(pad_end, "<?xpacket end", 13) != 0) pad_end = meta_end;
+  size_t content_len = meta_end - meta;
+  size_t region_len = pad_end - meta;
+
+  size_t val_off[XMP_MAX_EDITS], val_len[XMP_MAX_EDITS];
+  int n = xmp_find_dates(meta, content_len, val_off, val_len);
+  long delta = 0;
+  for (int i = 0; i < n; i++) delta += (long)new_len - (long)val_len[i];
+  if (n == 0) {
+   meta = meta_end;
+   continue;
+  }
+  size_t chunk;
+  if (xmp_container(map, len, format, meta - map, pad_end - map, &chunk) != 0) {
+   verbose_print("XMP packet at offset %zu is not inside a single %s segment in %s\n", (size_t)(meta - map), format_names[format], file);
+   no_room = 1;
+   meta = meta_end;
+   continue;
+  }
+  if (delta > (long)(region_len - content_len)) {
+   verbose_print("XMP packet at offset %zu has no room for %d dates in %s\n", (size_t)(meta - map), n, file);
+   no_room = 1;
+   meta = meta_end;
+   continue;
+  }
+
+  // Rebuild content with the new dates, then shrink or grow the padding to keep the size
+  unsigned char *buf = malloc(region_len);
+  if (!buf) break;
+  size_t src = 0, dst = 0;
+  for (int i = 0; i < n; i++) {
+   memcpy(buf + dst, meta + src, val_off[i] - src);
+   dst += val_off[i] - src;
+   memcpy(buf + dst, run_xmp_date, new_len);
+   dst += new_len;
+   src = val_off[i] + val_len[i];
+  }
+  memcpy(buf + dst, meta + src, content_len - src);
+  dst += content_len - src;
+  memset(buf + dst, ' ', region_len - dst);
+  if (region_len > dst && meta[region_len - 1] == '\n') buf[region_len - 1] = '\n';
+
+  int written = pwrite(fd, buf, region_len, meta - map) == (ssize_t)region_len;
+  if (written && chunk) {
+   // PNG: sum chunk type and data with the rebuilt region in place of the old one
+   size_t data_end = chunk + 8 + rd_be32(map + chunk);
+   uint32_t crc = crc32_update(0xFFFFFFFF, map + chunk + 4, (meta - map) - chunk - 4);
+   crc = crc32_update(crc, buf, region_len);
+   crc = crc32_update(crc, pad_end, data_end - (pad_end - map));
+   unsigned char crc_be[4];
+   wr_be32(crc_be, crc ^ 0xFFFFFFFF);
+   written = pwrite(fd, crc_be, 4, data_end) == 4;
+  }
+  if (written) {
+   verbose_print("Updated %d XMP dates natively for %s\n", n, file);
+   patched += n;
+  } else {
+   verbose_print("Failed to update XMP dates for %s\n", file);
+  }
+  free(buf);
+  meta = meta_end;
+ }
+
+ munmap(map, len);
+ if (no_room) return XMP_NO_ROOM;
+ return packets ? patched : XMP_NONE;
+}
+
+// Probe and write the metadata tags through exiftool, for formats without a native writer
+// Returns the number of exiftool writes run
+int exiftool_refresh_dates(const char *file) {
  char cmd[MAX_CMD];
+ int writes = 0;
 
- if (heuristic) {
-  // Heuristic mode
-  FILE *fp;
-  snprintf(cmd, MAX_CMD, "exiftool -a -G1 \"%s\"", file);
-  fp = popen(cmd, "r");
-  if (fp) {
-   char line[1024];
-   while (fgets(line, sizeof(line), fp)) {
-    if (strcasestr(line, "date")) {
-     char *colon = strchr(line, ':');
-     if (colon) {
-      *colon = '\0';
-      char *tag = line;
-      char *value = colon + 1;
-      // Clean up tag and value
-      while (*tag == ' ' || tag[0] == '[') tag++;
-      while (*value == ' ') value++;
-      char *tag_end = tag + strlen(tag) - 1;
-      while (*tag_end == ' ') *tag_end-- = '\0';
-      char *val_end = value + strlen(value) - 1;
-      while (*val_end == '\n' || *val_end == ' ') *val_end-- = '\0';
-
-      // Check if value looks like a date
-      if (strstr(value, ":") || strstr(value, "-") || strstr(value, "/")) {
-       if (strlen(value) >= 8) {  // Rough date length check
-        verbose_print("Updating heuristic tag %s for %s\n", tag, file);
-        snprintf(cmd, MAX_CMD, "exiftool -overwrite_original -\"%s=%s\" \"%s\" >/dev/null 2>&1", 
-          tag, date_str, file);
-        if (execute_command(cmd) == 0) {
-         verbose_print("Successfully updated %s\n", tag);
-        } else {
-         verbose_print("Failed to update %s\n", tag);
-        }
+ for (int i = 0; metadata_tags[i]; i++) {
+  if (tag_exists(file, metadata_tags[i])) {
+   verbose_print("Updating %s for %s\n", metadata_tags[i], file);
+   snprintf(cmd, MAX_CMD, "exiftool -overwrite_original -\"%s=%s\" \"%s\" >/dev/null 2>&1", 
+     metadata_tags[i], run_date, file);
+   writes++;
+   if (execute_command(cmd) == 0) {
+    verbose_print("Successfully updated %s\n", metadata_tags[i]);
+   } else {
+    verbose_print("Failed to update %s\n", metadata_tags[i]);
+   }
+  } else {
+   verbose_print("Skipping %s - not present in file\n", metadata_tags[i]);
+  }
+ }
+ return writes;
+}
+
+// Whether a -G1 group only holds dates that are set without exiftool
+static int native_group(const char *group, int native) {
+ if (strcmp(group, "System") == 0) return 1;  // file dates, set by utimensat at the end
+ if ((native & NATIVE_EXIF) && (strcmp(group, "IFD0") == 0 || strcmp(group, "ExifIFD") == 0)) return 1;
+ if ((native & NATIVE_QUICKTIME) && (strcmp(group, "QuickTime") == 0 || strncmp(group, "Track", 5) == 0)) return 1;
+ if ((native & NATIVE_XMP) && (strcmp(group, "XMP-xmp") == 0 || strcmp(group, "XMP-photoshop") == 0)) return 1;
+ return 0;
+}
+
+// Heuristic mode through exiftool: list every tag and rewrite those looking like dates,
+// except the groups in native (NATIVE_* flags) already refreshed in place
+// Returns the number of exiftool writes run
+int exiftool_heuristic(const char *file, int native) {
+ char cmd[MAX_CMD];
+ int writes = 0;
+ FILE *fp;
+ // -s prints tag names ("ModifyDate") that can be written back as -Group:Tag=
+ snprintf(cmd, MAX_CMD, "exiftool -a -G1 -s \"%s\"", file);
+ fp = popen(cmd, "r");
+ if (fp) {
+  char line[1024];
+  while (fgets(line, sizeof(line), fp)) {
+   if (strcasestr(line, "date")) {
+    // Lines look like "[Group]   TagName   : value"
+    char group[64] = "";
+    char *tag = line;
+    if (*tag == '[') {
+     char *end = strchr(tag, ']');
+     if (end && (size_t)(end - tag - 1) < sizeof(group)) {
+      memcpy(group, tag + 1, end - tag - 1);
+      group[end - tag - 1] = '\0';
+      tag = end + 1;
+     }
+    }
+    char *colon = strchr(tag, ':');
+    if (colon) {
+     *colon = '\0';
+     char *value = colon + 1;
+     // Clean up tag and value
+     while (*tag == ' ') tag++;
+     while (*value == ' ') value++;
+     char *tag_end = tag + strlen(tag) - 1;
+     while (tag_end > tag && *tag_end == ' ') *tag_end-- = '\0';
+     char *val_end = value + strlen(value) - 1;
+     while (val_end >= value && (*val_end == '\n' || *val_end == ' ')) *val_end-- = '\0';
+     if (native_group(group, native)) continue;
+
+     // Check if value looks like a date
+     if (strstr(value, ":") || strstr(value, "-") || strstr(value, "/")) {
+      if (strlen(value) >= 8) {  // Rough date length check
+       verbose_print("Updating heuristic tag %s%s%s for %s\n", group, *group ? ":" : "", tag, file);
+       snprintf(cmd, MAX_CMD, "exiftool -overwrite_original -\"%s%s%s=%s\" \"%s\" >/dev/null 2>&1", 
+         group, *group ? ":" : "", tag, run_date, file);
+       writes++;
+       if (execute_command(cmd) == 0) {
+        verbose_print("Successfully updated %s\n", tag);
+       } else {
+        verbose_print("Failed to update %s\n", tag);
        }
       }
      }
     }
    }
-   pclose(fp);
+  }
+  pclose(fp);
+ }
+ return writes;
+}
+
+// XMP sidecar files are text, the sniffer does not recognize them
+static int is_xmp_sidecar(const char *file) {
+ const char *dot = strrchr(file, '.');
+ return dot && strcasecmp(dot, ".xmp") == 0;
+}
+
+// Refresh the metadata and filesystem dates of a single file
+static void refresh_file(const char *file) {
+ // Read only files still get their dates refreshed, the native writers will just fail
+ int fd = open(file, O_RDWR);
+ if (fd < 0) fd = open(file, O_RDONLY);
+ if (fd < 0) {
+  verbose_print("Cannot open %s: %s\n", file, strerror(errno));
+  return;
+ }
+
+ struct stat st;
+ if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+  close(fd);
+  return;  // Skip if not a regular file
+ }
+
+ if (journal.fd >= 0) {
+  JournalKey key;
+  journal_key(&st, &key);
+  if (st.st_dev == journal.self_dev && st.st_ino == journal.self_ino) {
+   close(fd);
+   return;  // Never touch the journal itself
+  }
+  if (journal_contains(&key)) {
+   verbose_print("Skipping %s - already refreshed by this run\n", file);
+   close(fd);
+   return;
+  }
+  // Refreshed files carry the date of their run, so only newer changes are picked up
+  if (since && journal.last_run && st.st_mtime <= journal.last_run) {
+   verbose_print("Skipping %s - unchanged since last run\n", file);
+   close(fd);
+   return;
+  }
+ }
+
+ // One read of the header decides which writer handles the file
+ unsigned char head[SNIFF_SIZE];
+ ssize_t head_len = pread(fd, head, sizeof(head), 0);
+ FileFormat format = sniff_format(head, head_len > 0 ? (size_t)head_len : 0);
+
+ verbose_print("Processing: %s (%s)\n", file, format_names[format]);
+ verbose_print("Using date: %s\n", run_date);
+
+ // Unknown formats can never carry these tags, except XMP sidecars which are plain text
+ int has_tags = format != FMT_UNKNOWN || is_xmp_sidecar(file);
+ int exiftool_writes = 0;
+ if (heuristic) {
+  // Heuristic mode: container, EXIF and XMP dates are patched natively, the exiftool pass
+  // still rewrites every other date tag (PDF Info, QuickTime Keys, IPTC, PNG...) but skips
+  // the groups already done. Only recognized formats and .xmp sidecars are touched, a text
+  // or HTML file quoting an XMP packet is left alone.
+  if (has_tags) {
+   // A group counts as done only when no entry of it was left stale
+   int native = 0, skipped = 0;
+   if (format == FMT_QUICKTIME) {
+    if (mp4_refresh_dates(fd, st.st_size, file, run_time, &skipped) >= 0 && !skipped) native |= NATIVE_QUICKTIME;
+   } else if (format == FMT_JPEG || format == FMT_TIFF) {
+    if (exif_refresh_dates(fd, st.st_size, file, run_date, &skipped) >= 0 && !skipped) native |= NATIVE_EXIF;
+   }
+   if (xmp_refresh_dates(fd, st.st_size, file, format) >= 0) native |= NATIVE_XMP;
+   if (have_exiftool) {
+    exiftool_writes = exiftool_heuristic(file, native);
+   } else {
+    verbose_print("Skipping heuristic tags - exiftool is not installed\n");
+   }
+  } else {
+   verbose_print("Skipping metadata tags - unsupported format\n");
   }
  } else {
-  // Normal mode: process specific metadata tags
-  for (int i = 0; metadata_tags[i]; i++) {
-   if (tag_exists(file, metadata_tags[i])) {
-    verbose_print("Updating %s for %s\n", metadata_tags[i], file);
-    snprintf(cmd, MAX_CMD, "exiftool -overwrite_original -\"%s=%s\" \"%s\" >/dev/null 2>&1", 
-      metadata_tags[i], date_str, file);
-    if (execute_command(cmd) == 0) {
-     verbose_print("Successfully updated %s\n", metadata_tags[i]);
-    } else {
-     verbose_print("Failed to update %s\n", metadata_tags[i]);
-    }
+  // Normal mode: QuickTime/MP4 and EXIF dates are patched natively, exiftool only
+  // handles the other writable formats or native files we could not fully patch
+  int patched = -1, skipped = 0;
+  switch (format) {
+   case FMT_QUICKTIME:
+    patched = mp4_refresh_dates(fd, st.st_size, file, run_time, &skipped);
+    break;
+   case FMT_JPEG:
+   case FMT_TIFF:
+    patched = exif_refresh_dates(fd, st.st_size, file, run_date, &skipped);
+    break;
+   default:
+    break;
+  }
+  if (!has_tags) {
+   verbose_print("Skipping metadata tags - unsupported format\n");
+  } else if (patched <= 0 || skipped) {
+   if (have_exiftool) {
+    exiftool_writes = exiftool_refresh_dates(file);
    } else {
-    verbose_print("Skipping %s - not present in file\n", metadata_tags[i]);
+    verbose_print("Skipping metadata tags - exiftool is not installed\n");
    }
   }
  }
 
- // Process filesystem tags
- for (int i = 0; filesystem_tags[i]; i++) {
-  verbose_print("Updating %s for %s\n", filesystem_tags[i], file);
-  snprintf(cmd, MAX_CMD, "exiftool -P -\"%s=%s\" \"%s\" >/dev/null 2>&1", 
-    filesystem_tags[i], date_str, file);
-  if (execute_command(cmd) == 0) {
-   verbose_print("Successfully updated %s\n", filesystem_tags[i]);
-  } else {
-   verbose_print("Failed to update %s\n", filesystem_tags[i]);
-  }
+ // Filesystem tags: one utimensat sets FileModifyDate and FileAccessDate,
+ // FileInodeChangeDate cannot be set directly, the kernel bumps it to now on this call
+ // (futimens is utimensat on the descriptor we already hold, after all the writes above).
+ // exiftool -overwrite_original replaces the file by a rename, the descriptor then refers to
+ // the unlinked old inode : go through the path whenever exiftool wrote the file.
+ struct timespec times[2] = {{run_time, 0}, {run_time, 0}};
+ verbose_print("Updating FileModifyDate/FileAccessDate for %s\n", file);
+ int set = exiftool_writes ? utimensat(AT_FDCWD, file, times, 0) : futimens(fd, times);
+ if (set == 0) {
+  verbose_print("Successfully updated FileModifyDate/FileAccessDate\n");
+  // Journal the state after refresh, this is what a restart will see : stat the path,
+  // after an exiftool rewrite the descriptor still refers to the old inode
+  if (journal.fd >= 0 && stat(file, &st) == 0) journal_record(&st);
+ } else {
+  verbose_print("Failed to update FileModifyDate/FileAccessDate: %s\n", strerror(errno));
  }
+ close(fd);
  verbose_print("------------------------\n");
 }
 
+// Process a single file, its verbose lines are written out together once it is done
+void process_file(const char *file) {
+ char *text = NULL;
+ size_t len = 0;
+ if (verbose) verbose_buffer = open_memstream(&text, &len);
+ refresh_file(file);
+ if (!verbose_buffer) return;
+ fclose(verbose_buffer);
+ verbose_buffer = NULL;
+ pthread_mutex_lock(&output_lock);
+ fwrite(text, 1, len, stdout);
+ fflush(stdout);
+ pthread_mutex_unlock(&output_lock);
+ free(text);
+}
+
+// Hand a file to the worker pool, blocks while the queue is full
+void queue_push(const char *path) {
+ char *copy = strdup(path);
+ if (!copy) {
+  fprintf(stderr, "Error: Memory allocation failed for %s\n", path);
+  return;
+ }
+ pthread_mutex_lock(&queue.lock);
+ while (queue.count == QUEUE_SIZE) pthread_cond_wait(&queue.not_full, &queue.lock);
+ queue.paths[queue.tail] = copy;
+ queue.tail = (queue.tail + 1) % QUEUE_SIZE;
+ queue.count++;
+ pthread_cond_signal(&queue.not_empty);
+ pthread_mutex_unlock(&queue.lock);
+}
+
+// Take the next file, returns NULL once the walk is over and the queue drained
+char *queue_pop(void) {
+ pthread_mutex_lock(&queue.lock);
+ while (queue.count == 0 && !queue.done) pthread_cond_wait(&queue.not_empty, &queue.lock);
+ char *path = NULL;
+ if (queue.count > 0) {
+  path = queue.paths[queue.head];
+  queue.head = (queue.head + 1) % QUEUE_SIZE;
+  queue.count--;
+  pthread_cond_signal(&queue.not_full);
+ }
+ pthread_mutex_unlock(&queue.lock);
+ return path;
+}
+
+void *worker(void *arg) {
+ (void)arg;
+ char *path;
+ while ((path = queue_pop())) {
+  process_file(path);
+  free(path);
+ }
+ return NULL;
+}
+
 // Process directory recursively
 void process_directory(const char *dir) {
  DIR *dp = opendir(dir);
@@ -175,7 +1052,11 @@ void process_directory(const char *dir) {
   struct stat st;
   if (stat(path, &st) == 0) {
    if (S_ISREG(st.st_mode)) {
-    process_file(path);
+    if (jobs > 1) {
+     queue_push(path);
+    } else {
+     process_file(path);
+    }
    } else if (S_ISDIR(st.st_mode)) {
     process_directory(path);
    }
@@ -185,36 +1066,54 @@ void process_directory(const char *dir) {
 }
 
 int main(int argc, char *argv[]) {
- if (!check_exiftool()) {
-  fprintf(stderr, "Error: exiftool is not installed. Please install it first.\n");
-  fprintf(stderr, "On Debian/Ubuntu: sudo apt-get install libimage-exiftool-perl\n");
-  fprintf(stderr, "On Red Hat/Fedora: sudo dnf install perl-Image-ExifTool\n");
-  return 1;
- }
-
  // Parse arguments
  char *target = NULL;
+ char *journal_path = NULL;
  for (int i = 1; i < argc; i++) {
   if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
    verbose = 1;
   } else if (strcmp(argv[i], "--heuristic") == 0) {
    heuristic = 1;
+  } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+   journal_path = argv[++i];
+  } else if (strcmp(argv[i], "--since") == 0) {
+   since = 1;
+  } else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc) {
+   jobs = atoi(argv[++i]);
+   if (jobs < 1) {
+    fprintf(stderr, "Error: --jobs must be a positive number\n");
+    return 1;
+   }
   } else if (!target) {
    target = argv[i];
   } else {
    fprintf(stderr, "Error: Too many arguments\n");
-   fprintf(stderr, "Usage: %s [-v|--verbose] [--heuristic] <file/directory>\n", argv[0]);
+   fprintf(stderr, "Usage: %s [-v|--verbose] [--heuristic] [-j|--jobs N] [--journal FILE [--since]] <file/directory>\n", argv[0]);
    return 1;
   }
  }
 
+ // exiftool is only needed for the formats and XMP packets without a native path
+ have_exiftool = check_exiftool();
+ if (!have_exiftool) {
+  fprintf(stderr, "Warning: exiftool is not installed, only JPEG/TIFF/MP4/MOV%s metadata will be updated\n",
+    heuristic ? " and XMP" : "");
+  fprintf(stderr, "On Debian/Ubuntu: sudo apt-get install libimage-exiftool-perl\n");
+  fprintf(stderr, "On Red Hat/Fedora: sudo dnf install perl-Image-ExifTool\n");
+ }
+
+ // Capture the date once, every file gets the same timestamp
+ run_time = time(NULL);
+ struct tm *tm = localtime(&run_time);
+ strftime(run_date, sizeof(run_date), "%Y:%m:%d %H:%M:%S", tm);
+ char tz[8];
+ strftime(run_xmp_date, sizeof(run_xmp_date), "%Y-%m-%dT%H:%M:%S", tm);
+ strftime(tz, sizeof(tz), "%z", tm);
+ snprintf(run_xmp_date + 19, sizeof(run_xmp_date) - 19, "%.3s:%.2s", tz, tz + 3);
+
  if (!target) {
-  char date_str[20];
-  time_t now = time(NULL);
-  struct tm *tm = localtime(&now);
-  strftime(date_str, sizeof(date_str), "%Y:%m:%d %H:%M:%S", tm);
-  fprintf(stderr, "Usage: %s [-v|--verbose] [--heuristic] <file/directory>\n", argv[0]);
-  fprintf(stderr, "Will use current date: %s\n", date_str);
+  fprintf(stderr, "Usage: %s [-v|--verbose] [--heuristic] [-j|--jobs N] [--journal FILE [--since]] <file/directory>\n", argv[0]);
+  fprintf(stderr, "Will use current date: %s\n", run_date);
   return 1;
  }
 
@@ -224,15 +1123,53 @@ int main(int argc, char *argv[]) {
   return 1;
  }
 
+ if (since && !journal_path) {
+  fprintf(stderr, "Error: --since requires --journal\n");
+  return 1;
+ }
+ if (journal_path) {
+  if (journal_open(journal_path) != 0) return 1;
+  if (since && !journal.last_run) {
+   fprintf(stderr, "Warning: no completed run in %s, processing every file\n", journal_path);
+  }
+ }
+
  if (S_ISREG(st.st_mode)) {
   process_file(target);
  } else if (S_ISDIR(st.st_mode)) {
+  if (!jobs) {
+   long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+   jobs = cpus > 0 ? (int)cpus : 1;
+  }
+  pthread_t *workers = NULL;
+  if (jobs > 1) {
+   workers = calloc(jobs, sizeof(pthread_t));
+   if (!workers) {
+    fprintf(stderr, "Error: Memory allocation failed\n");
+    return 1;
+   }
+   for (int i = 0; i < jobs; i++) {
+    if (pthread_create(&workers[i], NULL, worker, NULL) != 0) {
+     fprintf(stderr, "Error: Cannot start worker thread\n");
+     return 1;
+    }
+   }
+  }
   process_directory(target);
+  if (workers) {
+   pthread_mutex_lock(&queue.lock);
+   queue.done = 1;
+   pthread_cond_broadcast(&queue.not_empty);
+   pthread_mutex_unlock(&queue.lock);
+   for (int i = 0; i < jobs; i++) pthread_join(workers[i], NULL);
+   free(workers);
+  }
  } else {
   fprintf(stderr, "Error: %s is not a valid file or directory\n", target);
   return 1;
  }
 
+ if (journal.fd >= 0) journal_close();
  verbose_print("Processing complete!\n");
  return 0;
 }
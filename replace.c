@@ -1,17 +1,60 @@
 // By Thibaut LOMBARD (LombardWeb)
 // Replace a given string by another Recursively
+// --index keeps a trigram index of file contents so that only files holding every trigram of the search string are read.
 // Compile : gcc -o replace replace.c
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #define MAX_PATH 4096
 #define BUFFER_SIZE 8192
+#define INDEX_MAGIC "RPLTRI01"
+#define INDEX_MAX_FILE (64L << 20)  // larger files are not indexed and always read
+#define INDEX_UNINDEXED 1
+#define TRIGRAM_SPACE (1u << 24)
+
+// Index file, native byte order : header, file table, postings (sorted uint32 file ids), trigram table sorted by trigram
+typedef struct {
+ char magic[8];
+ uint32_t file_count;
+ uint32_t trigram_count;
+ uint64_t files_offset;
+ uint64_t postings_offset;
+ uint64_t postings_count;
+ uint64_t trigrams_offset;
+} IndexHeader;
+
+// A file is identified by (dev, ino) and its postings are valid while size and mtime are unchanged
+typedef struct {
+ uint64_t dev, ino, size;
+ int64_t mtime_ns;
+ uint32_t flags;
+ uint32_t reserved;
+} IndexFile;
+
+typedef struct {
+ uint32_t trigram;
+ uint32_t count;
+ uint64_t first;  // position of the first file id in the postings
+} IndexTrigram;
+
+// Regular file met during the walk, the next index is built from these
+typedef struct {
+ char *path;
+ uint64_t dev, ino, size;
+ int64_t mtime_ns;
+ bool dirty;     // rewritten by this run
+ int64_t old_id; // entry of the loaded index that is still valid, -1 if the file must be read
+} IndexRecord;
 
 // Global variables for command-line arguments
 char *search_string = NULL;
@@ -19,14 +62,36 @@ char *replace_string = NULL;
 char *directory = NULL;
 bool verbose = false;
 char *operation = "comb_replace";
+char *index_path = NULL;
+
+// Loaded index (read-only mapping) and the files seen by this run
+struct {
+ unsigned char *map;
+ size_t map_size;
+ const IndexHeader *header;
+ const IndexFile *files;
+ const uint32_t *postings;
+ const IndexTrigram *trigrams;
+ uint32_t *slots;          // open addressing on (dev, ino), file id + 1, 0 marks an empty slot
+ size_t slot_count;
+ unsigned char *candidate; // per file id : holds every trigram of the search string
+ bool all_candidates;
+ bool has_self;
+ dev_t self_dev;
+ ino_t self_ino;
+ IndexRecord *records;
+ size_t record_count, record_cap;
+ bool renamed;
+} trigram_index = {.all_candidates = true};
 
 // Function to display usage
 void usage(const char *prog_name) {
- fprintf(stderr, "Usage: %s \"search_string\" \"replace_string\" [-i directory] [-v] [--opt {str_replace|fld_replace|comb_replace}]\n", prog_name);
+ fprintf(stderr, "Usage: %s \"search_string\" \"replace_string\" [-i directory] [-v] [--opt {str_replace|fld_replace|comb_replace|str_search}] [--index file]\n", prog_name);
  fprintf(stderr, "Examples:\n");
  fprintf(stderr, "  %s \"old\" \"new\"     # Default: comb_replace in current directory\n", prog_name);
  fprintf(stderr, "  %s \"old\" \"new\" -i /path -v    # comb_replace in specified directory with verbose output\n", prog_name);
  fprintf(stderr, "  %s \"old\" \"new\" -i /path --opt str_replace\n", prog_name);
+ fprintf(stderr, "  %s \"old\" \"\" -i /path --opt str_search --index /tmp/path.idx    # list files containing \"old\", reusing the index\n", prog_name);
  exit(EXIT_FAILURE);
 }
 
@@ -53,12 +118,12 @@ int replace_in_buffer(char *buffer, size_t buffer_size, const char *search, cons
  return replacements;
 }
 
-// Function to process a single file's contents
-void replace_in_file(const char *filepath) {
+// Function to process a single file's contents, returns the number of replacements written
+int replace_in_file(const char *filepath) {
  FILE *file = fopen(filepath, "r+");
  if (!file) {
   if (verbose) fprintf(stderr, "Cannot open file %s: %s\n", filepath, strerror(errno));
-  return;
+  return 0;
  }
 
  fseek(file, 0, SEEK_END);
@@ -66,15 +131,15 @@ void replace_in_file(const char *filepath) {
  if (file_size > BUFFER_SIZE - 1) {
   if (verbose) fprintf(stderr, "File %s too large for buffer\n", filepath);
   fclose(file);
-  return;
+  return 0;
  }
  rewind(file);
 
- char *buffer = malloc(file_size + 1);
+ char *buffer = malloc(BUFFER_SIZE); // replacements may grow the contents up to BUFFER_SIZE
  if (!buffer) {
   if (verbose) fprintf(stderr, "Memory allocation failed for %s\n", filepath);
   fclose(file);
-  return;
+  return 0;
  }
 
  size_t read_size = fread(buffer, 1, file_size, file);
@@ -101,6 +166,37 @@ void replace_in_file(const char *filepath) {
  free(buffer);
  if (temp_verbose) fclose(temp_verbose);
  fclose(file);
+ return replacements;
+}
+
+// Function to count the occurrences of the search string in a file (str_search, read-only)
+void search_in_file(const char *filepath) {
+ int fd = open(filepath, O_RDONLY);
+ if (fd < 0) {
+  if (verbose) fprintf(stderr, "Cannot open file %s: %s\n", filepath, strerror(errno));
+  return;
+ }
+ struct stat st;
+ if (fstat(fd, &st) != 0 || st.st_size == 0) {
+  close(fd);
+  return;
+ }
+ char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+ close(fd);
+ if (data == MAP_FAILED) {
+  if (verbose) fprintf(stderr, "Cannot map file %s: %s\n", filepath, strerror(errno));
+  return;
+ }
+
+ size_t search_len = strlen(search_string);
+ const char *pos = data, *end = data + st.st_size;
+ int matches = 0;
+ while ((pos = memmem(pos, end - pos, search_string, search_len)) != NULL) {
+  matches++;
+  pos += search_len;
+ }
+ if (matches > 0) printf("%s: %d\n", filepath, matches);
+ munmap(data, st.st_size);
 }
 
 // Function to replace string in a name and return new name
@@ -151,6 +247,7 @@ void rename_path(const char *old_path, const char *parent_dir) {
   
   snprintf(new_path, MAX_PATH, "%s/%s", parent_dir, new_basename);
   if (rename(old_path, new_path) == 0) {
+   trigram_index.renamed = true;
    if (verbose) {
     printf("Renamed: %s -> %s\n", old_path, new_path);
    }
@@ -161,6 +258,500 @@ void rename_path(const char *old_path, const char *parent_dir) {
  }
 }
 
+static int64_t mtime_ns(const struct stat *st) {
+ return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static size_t index_slot(uint64_t dev, uint64_t ino) {
+ uint64_t h = (ino ^ (dev << 40)) * 0x9E3779B97F4A7C15ULL;
+ return (size_t)(h >> 32) & (trigram_index.slot_count - 1);
+}
+
+// Entry of the loaded index for this inode, -1 if none
+static int64_t index_lookup(uint64_t dev, uint64_t ino) {
+ if (!trigram_index.slots) return -1;
+ for (size_t i = index_slot(dev, ino);; i = (i + 1) & (trigram_index.slot_count - 1)) {
+  uint32_t id = trigram_index.slots[i];
+  if (id == 0) return -1;
+  const IndexFile *f = &trigram_index.files[id - 1];
+  if (f->dev == dev && f->ino == ino) return id - 1;
+ }
+}
+
+// Map an existing index, a missing or unreadable one just means every file is read and indexed
+void index_open(const char *path) {
+ int fd = open(path, O_RDONLY);
+ if (fd < 0) {
+  if (errno != ENOENT) fprintf(stderr, "Warning: Cannot open index %s: %s\n", path, strerror(errno));
+  return;
+ }
+ struct stat st;
+ if (fstat(fd, &st) != 0) {
+  close(fd);
+  return;
+ }
+ trigram_index.has_self = true;
+ trigram_index.self_dev = st.st_dev;
+ trigram_index.self_ino = st.st_ino;
+ if ((size_t)st.st_size < sizeof(IndexHeader)) {
+  close(fd);
+  return;
+ }
+ unsigned char *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+ close(fd);
+ if (map == MAP_FAILED) return;
+
+ const IndexHeader *h = (const IndexHeader *)map;
+ uint64_t size = st.st_size;
+ if (memcmp(h->magic, INDEX_MAGIC, 8) != 0 || h->files_offset % 8 || h->postings_offset % 4 || h->trigrams_offset % 8
+   || h->files_offset > size || (size - h->files_offset) / sizeof(IndexFile) < h->file_count
+   || h->postings_offset > size || (size - h->postings_offset) / sizeof(uint32_t) < h->postings_count
+   || h->trigrams_offset > size || (size - h->trigrams_offset) / sizeof(IndexTrigram) < h->trigram_count) {
+  fprintf(stderr, "Warning: %s is not a valid index, rebuilding it\n", path);
+  munmap(map, st.st_size);
+  return;
+ }
+ trigram_index.map = map;
+ trigram_index.map_size = st.st_size;
+ trigram_index.header = h;
+ trigram_index.files = (const IndexFile *)(map + h->files_offset);
+ trigram_index.postings = (const uint32_t *)(map + h->postings_offset);
+ trigram_index.trigrams = (const IndexTrigram *)(map + h->trigrams_offset);
+
+ trigram_index.slot_count = 16;
+ while (trigram_index.slot_count < (size_t)h->file_count * 2) trigram_index.slot_count <<= 1;
+ trigram_index.slots = calloc(trigram_index.slot_count, sizeof(uint32_t));
+ if (!trigram_index.slots) return;
+ for (uint32_t id = 0; id < h->file_count; id++) {
+  const IndexFile *f = &trigram_index.files[id];
+  if (index_lookup(f->dev, f->ino) >= 0) continue;
+  size_t i = index_slot(f->dev, f->ino);
+  while (trigram_index.slots[i]) i = (i + 1) & (trigram_index.slot_count - 1);
+  trigram_index.slots[i] = id + 1;
+ }
+}
+
+static int compare_u32(const void *a, const void *b) {
+ uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+ return (x > y) - (x < y);
+}
+
+static int compare_trigram_count(const void *a, const void *b) {
+ const IndexTrigram *x = *(const IndexTrigram * const *)a, *y = *(const IndexTrigram * const *)b;
+ return (x->count > y->count) - (x->count < y->count);
+}
+
+static bool trigram_valid(const IndexTrigram *t) {
+ return t->first <= trigram_index.header->postings_count && t->count <= trigram_index.header->postings_count - t->first;
+}
+
+static const IndexTrigram *index_find_trigram(uint32_t trigram) {
+ size_t lo = 0, hi = trigram_index.header->trigram_count;
+ while (lo < hi) {
+  size_t mid = lo + (hi - lo) / 2;
+  uint32_t t = trigram_index.trigrams[mid].trigram;
+  if (t == trigram) return &trigram_index.trigrams[mid];
+  if (t < trigram) lo = mid + 1; else hi = mid;
+ }
+ return NULL;
+}
+
+static bool postings_contain(const IndexTrigram *t, uint32_t id) {
+ const uint32_t *p = trigram_index.postings + t->first;
+ size_t lo = 0, hi = t->count;
+ while (lo < hi) {
+  size_t mid = lo + (hi - lo) / 2;
+  if (p[mid] == id) return true;
+  if (p[mid] < id) lo = mid + 1; else hi = mid;
+ }
+ return false;
+}
+
+// Mark the indexed files holding every trigram of the pattern : start from the shortest postings
+// list and keep the ids found in all the others. Patterns under 3 bytes select every file.
+void index_select(const char *pattern) {
+ size_t len = strlen(pattern);
+ if (!trigram_index.slots || len < 3) return;
+ const IndexHeader *h = trigram_index.header;
+ trigram_index.candidate = calloc(h->file_count ? h->file_count : 1, 1);
+ uint32_t *grams = malloc((len - 2) * sizeof(uint32_t));
+ const IndexTrigram **lists = malloc((len - 2) * sizeof(IndexTrigram *));
+ if (!trigram_index.candidate || !grams || !lists) {
+  free(trigram_index.candidate);
+  trigram_index.candidate = NULL;
+  free(grams);
+  free(lists);
+  return;
+ }
+ trigram_index.all_candidates = false;
+
+ size_t n = 0;
+ for (size_t i = 0; i + 2 < len; i++) {
+  const unsigned char *c = (const unsigned char *)pattern + i;
+  grams[n++] = (uint32_t)c[0] << 16 | (uint32_t)c[1] << 8 | c[2];
+ }
+ qsort(grams, n, sizeof(uint32_t), compare_u32);
+ size_t count = 0;
+ for (size_t i = 0; i < n; i++) {
+  if (i > 0 && grams[i] == grams[i - 1]) continue;
+  lists[count] = index_find_trigram(grams[i]);
+  if (!lists[count]) goto done;  // no indexed file holds this trigram
+  if (!trigram_valid(lists[count])) {
+   trigram_index.all_candidates = true;
+   goto done;
+  }
+  count++;
+ }
+ qsort(lists, count, sizeof(IndexTrigram *), compare_trigram_count);
+
+ const uint32_t *first = trigram_index.postings + lists[0]->first;
+ for (uint32_t i = 0; i < lists[0]->count; i++) {
+  uint32_t id = first[i];
+  if (id >= h->file_count) continue;
+  size_t k = 1;
+  while (k < count && postings_contain(lists[k], id)) k++;
+  if (k == count) trigram_index.candidate[id] = 1;
+ }
+done:
+ free(grams);
+ free(lists);
+}
+
+// Whether a regular file must be read : new or changed since the index was built, too large to be
+// indexed, or holding every trigram of the search string
+bool index_wants(const struct stat *st) {
+ if (trigram_index.all_candidates) return true;
+ int64_t id = index_lookup(st->st_dev, st->st_ino);
+ if (id < 0) return true;
+ const IndexFile *f = &trigram_index.files[id];
+ if (f->size != (uint64_t)st->st_size || f->mtime_ns != mtime_ns(st)) return true;
+ return (f->flags & INDEX_UNINDEXED) || trigram_index.candidate[id];
+}
+
+bool index_is_self(const struct stat *st) {
+ return trigram_index.has_self && st->st_dev == trigram_index.self_dev && st->st_ino == trigram_index.self_ino;
+}
+
+// Remember a regular file for the next index, dirty when this run rewrote it
+void index_note(const char *path, const struct stat *st, bool dirty) {
+ if (!index_path) return;
+ if (trigram_index.record_count == trigram_index.record_cap) {
+  size_t cap = trigram_index.record_cap ? trigram_index.record_cap * 2 : 1024;
+  IndexRecord *records = realloc(trigram_index.records, cap * sizeof(IndexRecord));
+  if (!records) return;
+  trigram_index.records = records;
+  trigram_index.record_cap = cap;
+ }
+ char *copy = strdup(path);
+ if (!copy) return;
+ IndexRecord *r = &trigram_index.records[trigram_index.record_count++];
+ r->path = copy;
+ r->dev = st->st_dev;
+ r->ino = st->st_ino;
+ r->size = st->st_size;
+ r->mtime_ns = mtime_ns(st);
+ r->dirty = dirty;
+ r->old_id = -1;
+}
+
+// Walk the tree again after renames, the paths noted during the run are stale
+static void index_collect(const char *dir_path) {
+ DIR *dir = opendir(dir_path);
+ if (!dir) return;
+ struct dirent *entry;
+ char full_path[MAX_PATH];
+ while ((entry = readdir(dir)) != NULL) {
+  if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+  if (snprintf(full_path, MAX_PATH, "%s/%s", dir_path, entry->d_name) >= MAX_PATH) continue;
+  struct stat st;
+  if (stat(full_path, &st) == -1) continue;
+  if (S_ISDIR(st.st_mode)) {
+   index_collect(full_path);
+  } else if (S_ISREG(st.st_mode) && !index_is_self(&st)) {
+   index_note(full_path, &st, false);
+  }
+ }
+ closedir(dir);
+}
+
+static int compare_records_inode(const void *a, const void *b) {
+ const IndexRecord *x = a, *y = b;
+ if (x->dev != y->dev) return x->dev < y->dev ? -1 : 1;
+ if (x->ino != y->ino) return x->ino < y->ino ? -1 : 1;
+ return 0;
+}
+
+// Reused entries come first in their old order so that remapped postings stay sorted
+static int compare_records_old_id(const void *a, const void *b) {
+ const IndexRecord *x = a, *y = b;
+ if (x->old_id < 0 || y->old_id < 0) return (x->old_id < 0) - (y->old_id < 0);
+ return (x->old_id > y->old_id) - (x->old_id < y->old_id);
+}
+
+// Append the distinct trigrams of a file to grams, seen is a zeroed bitmap of the trigram space left zeroed
+static int index_read_file(const IndexRecord *r, uint32_t **grams, size_t *count, size_t *cap, uint8_t *seen) {
+ int fd = open(r->path, O_RDONLY);
+ if (fd < 0) return -1;
+ // Map what is there now : if the file changed since it was noted, its entry is stale next run anyway
+ struct stat st;
+ if (fstat(fd, &st) != 0 || st.st_size < 3) {
+  close(fd);
+  return 0;
+ }
+ uint64_t size = st.st_size;
+ const unsigned char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+ close(fd);
+ if (data == MAP_FAILED) return -1;
+
+ // A file has at most size - 2 distinct trigrams
+ if (*count + size > *cap) {
+  size_t new_cap = *cap ? *cap : 1 << 20;
+  while (new_cap < *count + size) new_cap *= 2;
+  uint32_t *grown = realloc(*grams, new_cap * sizeof(uint32_t));
+  if (!grown) {
+   munmap((void *)data, size);
+   errno = ENOMEM;
+   return -1;
+  }
+  *grams = grown;
+  *cap = new_cap;
+ }
+ size_t start = *count;
+ uint32_t t = (uint32_t)data[0] << 8 | data[1];
+ for (uint64_t i = 2; i < size; i++) {
+  t = (t << 8 | data[i]) & (TRIGRAM_SPACE - 1);
+  if (seen[t >> 3] & (1 << (t & 7))) continue;
+  seen[t >> 3] |= 1 << (t & 7);
+  (*grams)[(*count)++] = t;
+ }
+ munmap((void *)data, size);
+ for (size_t i = start; i < *count; i++) seen[(*grams)[i] >> 3] = 0;
+ return 0;
+}
+
+// Buffered postings output
+typedef struct {
+ FILE *out;
+ uint32_t buf[16384];
+ size_t used;
+ uint64_t written;
+} PostingsWriter;
+
+static void postings_put(PostingsWriter *w, uint32_t id) {
+ w->buf[w->used++] = id;
+ w->written++;
+ if (w->used == sizeof(w->buf) / sizeof(w->buf[0])) {
+  fwrite(w->buf, sizeof(uint32_t), w->used, w->out);
+  w->used = 0;
+ }
+}
+
+// Write the index for the files of this run : still valid entries keep their postings from the old
+// index, new and changed files are read. Written to a temporary file then renamed over the old one.
+int index_save(const char *path) {
+ if (trigram_index.renamed) {
+  // Carry the rewritten inodes over to the new walk
+  uint64_t *dirty = malloc((trigram_index.record_count + 1) * 2 * sizeof(uint64_t));
+  size_t dirty_count = 0;
+  for (size_t i = 0; i < trigram_index.record_count; i++) {
+   IndexRecord *r = &trigram_index.records[i];
+   if (r->dirty && dirty) {
+    dirty[dirty_count * 2] = r->dev;
+    dirty[dirty_count * 2 + 1] = r->ino;
+    dirty_count++;
+   }
+   free(r->path);
+  }
+  trigram_index.record_count = 0;
+  index_collect(directory);
+  for (size_t i = 0; i < trigram_index.record_count; i++) {
+   IndexRecord *r = &trigram_index.records[i];
+   for (size_t k = 0; k < dirty_count && !r->dirty; k++) {
+    r->dirty = dirty[k * 2] == r->dev && dirty[k * 2 + 1] == r->ino;
+   }
+  }
+  free(dirty);
+ }
+
+ // One entry per inode (hard links), then decide which entries are still valid
+ IndexRecord *records = trigram_index.records;
+ size_t n = 0, reused = 0, read = 0;
+ if (trigram_index.record_count) qsort(records, trigram_index.record_count, sizeof(IndexRecord), compare_records_inode);
+ for (size_t i = 0; i < trigram_index.record_count; i++) {
+  if (n > 0 && compare_records_inode(&records[n - 1], &records[i]) == 0) {
+   records[n - 1].dirty |= records[i].dirty;
+   free(records[i].path);
+   continue;
+  }
+  records[n++] = records[i];
+ }
+ trigram_index.record_count = n;
+ for (size_t i = 0; i < n; i++) {
+  IndexRecord *r = &records[i];
+  int64_t id = r->dirty ? -1 : index_lookup(r->dev, r->ino);
+  if (id >= 0 && trigram_index.files[id].size == r->size && trigram_index.files[id].mtime_ns == r->mtime_ns) {
+   r->old_id = id;
+   reused++;
+  }
+ }
+ uint32_t old_count = trigram_index.slots ? trigram_index.header->file_count : 0;
+ if (trigram_index.slots && reused == n && n == old_count) {
+  if (verbose) printf("Index %s: %zu files, unchanged\n", path, n);
+  return 0;
+ }
+ if (n) qsort(records, n, sizeof(IndexRecord), compare_records_old_id);
+
+ uint32_t *old_to_new = malloc((old_count ? old_count : 1) * sizeof(uint32_t));
+ IndexFile *files = malloc((n ? n : 1) * sizeof(IndexFile));
+ uint32_t *fresh_ids = malloc((n ? n : 1) * sizeof(uint32_t));
+ size_t *fresh_ends = malloc((n ? n : 1) * sizeof(size_t));
+ uint8_t *seen = calloc(TRIGRAM_SPACE / 8, 1);
+ uint32_t *grams = NULL, *ids = NULL, *bucket_end = NULL;
+ size_t gram_count = 0, gram_cap = 0, fresh_count = 0;
+ int status = -1;
+ PostingsWriter *w = calloc(1, sizeof(PostingsWriter));
+ IndexTrigram *table = NULL;
+ char tmp_path[MAX_PATH];
+ if (!old_to_new || !files || !fresh_ids || !fresh_ends || !seen || !w) goto out;
+ memset(old_to_new, 0xff, (old_count ? old_count : 1) * sizeof(uint32_t));
+
+ uint32_t file_count = 0;
+ for (size_t i = 0; i < n; i++) {
+  IndexRecord *r = &records[i];
+  IndexFile *f = &files[file_count];
+  f->dev = r->dev;
+  f->ino = r->ino;
+  f->size = r->size;
+  f->mtime_ns = r->mtime_ns;
+  f->reserved = 0;
+  if (r->old_id >= 0) {
+   f->flags = trigram_index.files[r->old_id].flags;
+   old_to_new[r->old_id] = file_count++;
+  } else if (r->size > INDEX_MAX_FILE) {
+   f->flags = INDEX_UNINDEXED;
+   file_count++;
+  } else {
+   f->flags = 0;
+   if (index_read_file(r, &grams, &gram_count, &gram_cap, seen) != 0) {
+    if (verbose) fprintf(stderr, "Cannot index %s: %s\n", r->path, strerror(errno));
+    continue;  // left out, read again next run
+   }
+   fresh_ids[fresh_count] = file_count++;
+   fresh_ends[fresh_count++] = gram_count;
+   read++;
+  }
+ }
+ if (gram_count >= UINT32_MAX) {
+  fprintf(stderr, "Error: Too many trigrams to index\n");
+  goto out;
+ }
+
+ // Counting sort of the new trigrams : ids holds, trigram by trigram, the files read by this run in id order
+ bucket_end = calloc(TRIGRAM_SPACE, sizeof(uint32_t));
+ ids = malloc((gram_count ? gram_count : 1) * sizeof(uint32_t));
+ if (!bucket_end || !ids) goto out;
+ for (size_t i = 0; i < gram_count; i++) bucket_end[grams[i]]++;
+ uint32_t sum = 0;
+ for (uint32_t t = 0; t < TRIGRAM_SPACE; t++) {
+  uint32_t c = bucket_end[t];
+  bucket_end[t] = sum;
+  sum += c;
+ }
+ for (size_t k = 0, i = 0; k < fresh_count; k++) {
+  for (; i < fresh_ends[k]; i++) ids[bucket_end[grams[i]]++] = fresh_ids[k];
+ }
+ free(grams);
+ grams = NULL;
+
+ snprintf(tmp_path, MAX_PATH, "%s.tmp", path);
+ w->out = fopen(tmp_path, "wb");
+ if (!w->out) {
+  fprintf(stderr, "Error: Cannot write index %s: %s\n", tmp_path, strerror(errno));
+  goto out;
+ }
+ IndexHeader header;
+ memset(&header, 0, sizeof(header));
+ fwrite(&header, sizeof(header), 1, w->out);
+ header.files_offset = sizeof(header);
+ fwrite(files, sizeof(IndexFile), file_count, w->out);
+ header.postings_offset = header.files_offset + (uint64_t)file_count * sizeof(IndexFile);
+
+ // Per trigram : the remapped old postings (reused files have the lowest new ids), then the files read now
+ size_t table_cap = 1 << 16, table_count = 0;
+ table = malloc(table_cap * sizeof(IndexTrigram));
+ if (!table) goto out;
+ uint32_t old_trigrams = trigram_index.slots ? trigram_index.header->trigram_count : 0;
+ size_t ot = 0;
+ for (uint32_t t = 0; t < TRIGRAM_SPACE; t++) {
+  uint64_t first = w->written;
+  while (ot < old_trigrams && trigram_index.trigrams[ot].trigram < t) ot++;
+  if (ot < old_trigrams && trigram_index.trigrams[ot].trigram == t && trigram_valid(&trigram_index.trigrams[ot])) {
+   const IndexTrigram *old = &trigram_index.trigrams[ot];
+   const uint32_t *old_ids = trigram_index.postings + old->first;
+   for (uint32_t i = 0; i < old->count; i++) {
+    if (old_ids[i] < old_count && old_to_new[old_ids[i]] != UINT32_MAX) postings_put(w, old_to_new[old_ids[i]]);
+   }
+  }
+  for (uint32_t i = t ? bucket_end[t - 1] : 0; i < bucket_end[t]; i++) postings_put(w, ids[i]);
+  if (w->written == first) continue;
+  if (table_count == table_cap) {
+   IndexTrigram *grown = realloc(table, table_cap * 2 * sizeof(IndexTrigram));
+   if (!grown) goto out;
+   table = grown;
+   table_cap *= 2;
+  }
+  table[table_count].trigram = t;
+  table[table_count].count = (uint32_t)(w->written - first);
+  table[table_count].first = first;
+  table_count++;
+ }
+ if (w->written % 2) postings_put(w, 0);  // keep the trigram table 8-byte aligned in the mapping
+ fwrite(w->buf, sizeof(uint32_t), w->used, w->out);
+ header.postings_count = w->written;
+ header.trigrams_offset = header.postings_offset + w->written * sizeof(uint32_t);
+ fwrite(table, sizeof(IndexTrigram), table_count, w->out);
+ memcpy(header.magic, INDEX_MAGIC, 8);
+ header.file_count = file_count;
+ header.trigram_count = (uint32_t)table_count;
+ if (fseek(w->out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, w->out) != 1 || fflush(w->out) != 0 || fsync(fileno(w->out)) != 0) {
+  fprintf(stderr, "Error: Cannot write index %s: %s\n", tmp_path, strerror(errno));
+  goto out;
+ }
+ fclose(w->out);
+ w->out = NULL;
+ if (rename(tmp_path, path) != 0) {
+  fprintf(stderr, "Error: Cannot replace index %s: %s\n", path, strerror(errno));
+  goto out;
+ }
+ if (verbose) printf("Index %s: %u files, %zu reused, %zu read\n", path, file_count, reused, read);
+ status = 0;
+
+out:
+ if (w && w->out) {
+  fclose(w->out);
+  remove(tmp_path);
+ }
+ free(w);
+ free(table);
+ free(bucket_end);
+ free(ids);
+ free(grams);
+ free(seen);
+ free(fresh_ends);
+ free(fresh_ids);
+ free(files);
+ free(old_to_new);
+ return status;
+}
+
+void index_close(void) {
+ for (size_t i = 0; i < trigram_index.record_count; i++) free(trigram_index.records[i].path);
+ free(trigram_index.records);
+ free(trigram_index.slots);
+ free(trigram_index.candidate);
+ if (trigram_index.map) munmap(trigram_index.map, trigram_index.map_size);
+}
+
 // Function to process directory recursively
 void process_directory(const char *dir_path) {
  DIR *dir = opendir(dir_path);
@@ -188,8 +779,20 @@ void process_directory(const char *dir_path) {
    continue;
   }
 
-  if (S_ISREG(st.st_mode) && (strcmp(operation, "str_replace") == 0 || strcmp(operation, "comb_replace") == 0)) {
-   replace_in_file(full_path);
+  if (S_ISREG(st.st_mode)) {
+   if (index_is_self(&st)) continue; // Never read, rewrite or rename the index itself
+   int replacements = 0;
+   if (strcmp(operation, "fld_replace") != 0 && index_wants(&st)) {
+    if (strcmp(operation, "str_search") == 0) {
+     search_in_file(full_path);
+    } else {
+     replacements = replace_in_file(full_path);
+    }
+   }
+   // Note the rewritten file as it is now, so that the next run finds its entry unchanged
+   struct stat rewritten;
+   if (replacements > 0 && stat(full_path, &rewritten) == 0) st = rewritten;
+   index_note(full_path, &st, replacements > 0);
   } else if (S_ISDIR(st.st_mode)) {
    process_directory(full_path); // Recurse into subdirectory
   }
@@ -222,24 +825,43 @@ int main(int argc, char *argv[]) {
    verbose = true;
   } else if (strcmp(argv[i], "--opt") == 0) {
    if (++i >= argc) usage(argv[0]);
-   if (strcmp(argv[i], "str_replace") == 0 || strcmp(argv[i], "fld_replace") == 0 || strcmp(argv[i], "comb_replace") == 0) {
+   if (strcmp(argv[i], "str_replace") == 0 || strcmp(argv[i], "fld_replace") == 0 || strcmp(argv[i], "comb_replace") == 0 || strcmp(argv[i], "str_search") == 0) {
     operation = argv[i];
    } else {
-    fprintf(stderr, "Error: Invalid operation. Use str_replace, fld_replace, or comb_replace\n");
+    fprintf(stderr, "Error: Invalid operation. Use str_replace, fld_replace, comb_replace, or str_search\n");
     exit(EXIT_FAILURE);
    }
+  } else if (strcmp(argv[i], "--index") == 0) {
+   if (++i >= argc) usage(argv[0]);
+   index_path = argv[i];
   } else {
    fprintf(stderr, "Unknown option: %s\n", argv[i]);
    usage(argv[0]);
   }
  }
 
+ if (search_string[0] == '\0') {
+  fprintf(stderr, "Error: Empty search string\n");
+  exit(EXIT_FAILURE);
+ }
+
  if (verbose) {
   printf("Processing directory: %s\n", directory);
  }
 
+ if (index_path) {
+  index_open(index_path);
+  index_select(search_string);
+ }
+
  process_directory(directory);
 
+ int status = EXIT_SUCCESS;
+ if (index_path) {
+  if (index_save(index_path) != 0) status = EXIT_FAILURE;
+  index_close();
+ }
+
  free(directory);
- return EXIT_SUCCESS;
+ return status;
 }